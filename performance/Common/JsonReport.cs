@@ -0,0 +1,35 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Globalization;
+using System.IO;
+
+namespace Performance
+{
+    static class JsonReport
+    {
+        // Flat JSON object from name/value pairs for regression tracking scripts
+        public static void Write(string path, params object[] values)
+        {
+            var items = new List<string>();
+            for (int i = 0; (i + 1) < values.Length; i += 2)
+                items.Add($"\"{values[i]}\": {Format(values[i + 1])}");
+            File.WriteAllText(path, "{ " + string.Join(", ", items) + " }" + Environment.NewLine);
+        }
+
+        static string Format(object value)
+        {
+            if (value == null)
+                return "null";
+            if (value is string)
+                return "\"" + ((string)value).Replace("\\", "\\\\").Replace("\"", "\\\"") + "\"";
+
+            // JSON has no NaN or Infinity, e.g. percentiles of an empty histogram
+            if ((value is double) && (double.IsNaN((double)value) || double.IsInfinity((double)value)))
+                return "null";
+            if ((value is float) && (float.IsNaN((float)value) || float.IsInfinity((float)value)))
+                return "null";
+
+            return Convert.ToString(value, CultureInfo.InvariantCulture);
+        }
+    }
+}
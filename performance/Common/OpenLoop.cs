@@ -0,0 +1,121 @@
+﻿using System;
+using System.Diagnostics;
+using System.Threading;
+using CSharpServer;
+
+namespace Performance
+{
+    // Open-loop load: messages are sent at the fixed rate and timed from their intended send times
+    static class OpenLoop
+    {
+        public static Histogram Latency = new Histogram();
+        public static Histogram ServiceTime = new Histogram();
+        public static long Received;
+        public static long Outstanding;
+
+        public static void Prepare(long messages)
+        {
+            _intended = new long[messages];
+            _actual = new long[messages];
+            _recorded = new int[messages];
+        }
+
+        // Send messages with the fixed schedule, the sender puts the given sequence number into the message
+        public static void Send(int rate, long messages, Action<long> send)
+        {
+            double interval = (double)Stopwatch.Frequency / rate;
+            long start = Stopwatch.GetTimestamp();
+            for (long i = 0; i < messages; ++i)
+            {
+                // Intended send time follows the fixed schedule regardless of when previous messages were sent
+                long intended = start + (long)(i * interval);
+                long wait;
+                while ((wait = intended - Stopwatch.GetTimestamp()) > 0)
+                {
+                    if (wait > Stopwatch.Frequency / 1000)
+                        Thread.Sleep(1);
+                    else
+                        Thread.SpinWait(10);
+                }
+
+                _intended[i] = intended;
+                _actual[i] = Stopwatch.GetTimestamp();
+                send(i);
+            }
+        }
+
+        // Record the echo of the message with the given sequence number
+        public static void Record(long sequence)
+        {
+            if ((sequence < 0) || (sequence >= _recorded.Length))
+                return;
+
+            // Duplicates and echoes after the cutoff are already recorded
+            if (Interlocked.Exchange(ref _recorded[sequence], 1) != 0)
+                return;
+
+            RecordElapsed(sequence, Stopwatch.GetTimestamp());
+            Interlocked.Increment(ref Received);
+        }
+
+        public static void Wait(long messages)
+        {
+            // Wait for all echoes or stop when nothing is received for a while
+            long received = -1;
+            DateTime progress = DateTime.UtcNow;
+            while (Interlocked.Read(ref Received) < messages)
+            {
+                long current = Interlocked.Read(ref Received);
+                if (current != received)
+                {
+                    received = current;
+                    progress = DateTime.UtcNow;
+                }
+                else if ((DateTime.UtcNow - progress).TotalSeconds > 5)
+                    break;
+                Thread.Sleep(10);
+            }
+
+            // Messages still outstanding at the cutoff are recorded with the time elapsed so far,
+            // so lost or stalled messages are not dropped from the percentiles
+            long now = Stopwatch.GetTimestamp();
+            for (long i = 0; i < messages; ++i)
+            {
+                if (Interlocked.Exchange(ref _recorded[i], 1) == 0)
+                {
+                    RecordElapsed(i, now);
+                    ++Outstanding;
+                }
+            }
+        }
+
+        public static void Print()
+        {
+            Console.WriteLine($"Timed messages: {Received}");
+            Console.WriteLine($"Outstanding messages: {Outstanding}");
+            PrintPercentiles("Latency", Latency);
+            PrintPercentiles("Service time", ServiceTime);
+        }
+
+        public static void PrintPercentiles(string name, Histogram histogram)
+        {
+            Console.WriteLine($"{name} p50: {Service.GenerateTimePeriod(histogram.Percentile(50.0) / 1000000.0)}");
+            Console.WriteLine($"{name} p99: {Service.GenerateTimePeriod(histogram.Percentile(99.0) / 1000000.0)}");
+            Console.WriteLine($"{name} p99.9: {Service.GenerateTimePeriod(histogram.Percentile(99.9) / 1000000.0)}");
+            Console.WriteLine($"{name} max: {Service.GenerateTimePeriod(histogram.Max / 1000000.0)}");
+        }
+
+        static void RecordElapsed(long sequence, long now)
+        {
+            // Latency from the intended send time includes the time the message waited
+            // behind a stalled sender, so it is not hidden by coordinated omission
+            Latency.Record((long)((now - _intended[sequence]) * NanosecondsPerTick));
+            ServiceTime.Record((long)((now - _actual[sequence]) * NanosecondsPerTick));
+        }
+
+        private static readonly double NanosecondsPerTick = 1000000000.0 / Stopwatch.Frequency;
+        private static long[] _intended;
+        private static long[] _actual;
+        private static int[] _recorded;
+    }
+}
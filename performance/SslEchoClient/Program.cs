@@ -3,6 +3,7 @@ using System.Collections.Generic;
 using System.Threading;
 using CSharpServer;
 using NDesk.Options;
+using Performance;
 
 namespace SslEchoClient
 {
@@ -19,11 +20,15 @@ namespace SslEchoClient
         protected override void OnHandshaked()
         {
             Handshaked = true;
-            SendMessage();
+            if (Program.Rate == 0)
+                SendMessage();
         }
 
         protected override void OnSent(long sent, long pending)
         {
+            if (Program.Rate > 0)
+                return;
+
             _sent += sent;
             if (_sent >= Program.MessageToSend.Length)
             {
@@ -34,6 +39,14 @@ namespace SslEchoClient
 
         protected override void OnReceived(byte[] buffer, long size)
         {
+            if (Program.Rate > 0)
+            {
+                ReceiveTimed(buffer, size);
+                Program.TimestampStop = DateTime.UtcNow;
+                Program.TotalBytes += size;
+                return;
+            }
+
             _received += size;
             while (_received >= Program.MessageToSend.Length)
             {
@@ -51,6 +64,38 @@ namespace SslEchoClient
             ++Program.TotalErrors;
         }
 
+        public void PrepareTimed()
+        {
+            _timedMessage = new byte[Program.MessageToSend.Length];
+            _timedReceived = new byte[Program.MessageToSend.Length];
+        }
+
+        public void SendTimed(long sequence)
+        {
+            // Sequence number in the message is used to find its send times
+            for (int i = 0; i < 8; ++i)
+                _timedMessage[i] = (byte)(sequence >> (8 * i));
+            SendAsync(_timedMessage);
+        }
+
+        private void ReceiveTimed(byte[] buffer, long size)
+        {
+            long offset = 0;
+            while (offset < size)
+            {
+                long chunk = Math.Min(size - offset, _timedReceived.Length - _timedOffset);
+                Array.Copy(buffer, offset, _timedReceived, _timedOffset, chunk);
+                _timedOffset += (int)chunk;
+                offset += chunk;
+
+                if (_timedOffset == _timedReceived.Length)
+                {
+                    _timedOffset = 0;
+                    OpenLoop.Record(BitConverter.ToInt64(_timedReceived, 0));
+                }
+            }
+        }
+
         private void SendMessage()
         {
             if (_messagesOutput-- > 0)
@@ -63,6 +108,9 @@ namespace SslEchoClient
                 DisconnectAsync();
         }
 
+        private byte[] _timedMessage;
+        private byte[] _timedReceived;
+        private int _timedOffset;
         private int _messagesOutput;
         private int _messagesInput;
         private long _sent;
@@ -77,16 +125,19 @@ namespace SslEchoClient
         public static long TotalErrors;
         public static long TotalBytes;
         public static long TotalMessages;
+        public static int Rate;
 
         static void Main(string[] args)
         {
             bool help = false;
+            string json = null;
             string address = "127.0.0.1";
             int port = 2222;
             int threads = Environment.ProcessorCount;
             int clients = 100;
             int messages = 1000000;
             int size = 32;
+            int duration = 10;
 
             var options = new OptionSet()
             {
@@ -96,7 +147,10 @@ namespace SslEchoClient
                 { "t|threads=", v => threads = int.Parse(v) },
                 { "c|clients=", v => clients = int.Parse(v) },
                 { "m|messages=", v => messages = int.Parse(v) },
-                { "s|size=", v => size = int.Parse(v) }
+                { "s|size=", v => size = int.Parse(v) },
+                { "r|rate=", v => Rate = int.Parse(v) },
+                { "d|duration=", v => duration = int.Parse(v) },
+                { "j|json=", v => json = v }
             };
 
             try
@@ -118,15 +172,29 @@ namespace SslEchoClient
                 return;
             }
 
+            // Open-loop messages carry 8 bytes of the sequence number
+            if (Rate > 0)
+            {
+                size = Math.Max(size, 8);
+                messages = Rate * duration;
+            }
+
             Console.WriteLine($"Server address: {address}");
             Console.WriteLine($"Server port: {port}");
             Console.WriteLine($"Working threads: {threads}");
             Console.WriteLine($"Working clients: {clients}");
             Console.WriteLine($"Messages to send: {messages}");
             Console.WriteLine($"Message size: {size}");
+            if (Rate > 0)
+            {
+                Console.WriteLine($"Open-loop rate: {Rate} msg/s");
+                Console.WriteLine($"Open-loop duration: {duration} s");
+            }
 
             // Prepare a message to send
             MessageToSend = new byte[size];
+            if (Rate > 0)
+                OpenLoop.Prepare(messages);
 
             // Create a new service
             var service = new Service(threads);
@@ -146,6 +214,8 @@ namespace SslEchoClient
             for (int i = 0; i < clients; ++i)
             {
                 var client = new EchoClient(service, context, address, port, messages / clients);
+                if (Rate > 0)
+                    client.PrepareTimed();
                 // client.SetupNoDelay(true);
                 echoClients.Add(client);
             }
@@ -164,6 +234,20 @@ namespace SslEchoClient
             }
             Console.WriteLine("All clients connected!");
 
+            // Send messages at the fixed rate in open-loop mode
+            if (Rate > 0)
+            {
+                TimestampStart = DateTime.UtcNow;
+                Console.Write("Sending...");
+                OpenLoop.Send(Rate, messages, sequence => echoClients[(int)(sequence % echoClients.Count)].SendTimed(sequence));
+                Console.WriteLine("Done!");
+                Console.Write("Receiving...");
+                OpenLoop.Wait(messages);
+                Console.WriteLine("Done!");
+                foreach (var client in echoClients)
+                    client.DisconnectAsync();
+            }
+
             // Wait for processing all messages
             Console.Write("Processing...");
             foreach (var client in echoClients)
@@ -195,6 +279,30 @@ namespace SslEchoClient
                 Console.WriteLine($"Message latency: {Service.GenerateTimePeriod((TimestampStop - TimestampStart).TotalMilliseconds / TotalMessages)}");
                 Console.WriteLine($"Message throughput: {(long)(TotalMessages / (TimestampStop - TimestampStart).TotalSeconds)} msg/s");
             }
+
+            if (Rate > 0)
+            {
+                Console.WriteLine();
+
+                OpenLoop.Print();
+            }
+
+            // Write machine-readable results
+            if (json != null)
+                JsonReport.Write(json,
+                    "benchmark", "SslEchoClient",
+                    "clients", clients,
+                    "size", size,
+                    "rate", Rate,
+                    "errors", TotalErrors,
+                    "seconds", (TimestampStop - TimestampStart).TotalSeconds,
+                    "bytes", TotalBytes,
+                    "messages", TotalMessages,
+                    "outstanding", OpenLoop.Outstanding,
+                    "latency_p50_ns", OpenLoop.Latency.Percentile(50.0),
+                    "latency_p99_ns", OpenLoop.Latency.Percentile(99.0),
+                    "latency_p999_ns", OpenLoop.Latency.Percentile(99.9),
+                    "latency_max_ns", OpenLoop.Latency.Max);
         }
     }
 }
@@ -1,4 +1,8 @@
 ﻿using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Linq;
+using System.Threading;
 using CSharpServer;
 using NDesk.Options;
 
@@ -14,6 +18,12 @@ namespace SslEchoServer
             SendAsync(buffer, 0, size);
         }
 
+        protected override void OnDisconnected()
+        {
+            Interlocked.Add(ref Program.TotalBytesSent, BytesSent);
+            Interlocked.Add(ref Program.TotalBytesEncrypted, BytesEncrypted);
+        }
+
         protected override void OnError(int error, string category, string message)
         {
             Console.WriteLine($"Session caught an error with code {error} and category '{category}': {message}");
@@ -34,17 +44,44 @@ namespace SslEchoServer
 
     class Program
     {
+        public static long TotalBytesSent;
+        public static long TotalBytesEncrypted;
+
+        static SslContext CreateContext()
+        {
+            // Create and prepare a new SSL server context
+            var context = new SslContext(SslMethod.TLSV12);
+            context.SetPassword("qwerty");
+            context.UseCertificateChainFile("server.pem");
+            context.UsePrivateKeyFile("server.pem", SslFileFormat.PEM);
+            context.UseTmpDHFile("dh4096.pem");
+            context.SetSessionIdContext("SslEchoServer");
+            return context;
+        }
+
         static void Main(string[] args)
         {
             bool help = false;
             int port = 2222;
             int threads = Environment.ProcessorCount;
+            int rotate = 0;
+            int limit = 0;
+            int reload = 0;
+            int coalesce = 0;
+            int delay = 100;
+            bool dynamic = false;
 
             var options = new OptionSet()
             {
                 { "h|?|help",   v => help = v != null },
                 { "p|port=", v => port = int.Parse(v) },
-                { "t|threads=", v => threads = int.Parse(v) }
+                { "t|threads=", v => threads = int.Parse(v) },
+                { "r|rotate=", v => rotate = int.Parse(v) },
+                { "l|limit=", v => limit = int.Parse(v) },
+                { "c|reload=", v => reload = int.Parse(v) },
+                { "q|coalesce=", v => coalesce = int.Parse(v) },
+                { "d|delay=", v => delay = int.Parse(v) },
+                { "y|dynamic", v => dynamic = v != null }
             };
 
             try
@@ -68,6 +105,16 @@ namespace SslEchoServer
 
             Console.WriteLine($"Server port: {port}");
             Console.WriteLine($"Working threads: {threads}");
+            if (rotate > 0)
+                Console.WriteLine($"Session ticket key rotation: {rotate} seconds");
+            if (limit > 0)
+                Console.WriteLine($"Handshake limit: {limit}");
+            if (reload > 0)
+                Console.WriteLine($"Certificate reload: {reload} seconds");
+            if (coalesce > 0)
+                Console.WriteLine($"Send coalescing: {coalesce} bytes / {delay} microseconds");
+            if (dynamic)
+                Console.WriteLine("Dynamic record size: enabled");
 
             // Create a new service
             var service = new Service(threads);
@@ -78,17 +125,38 @@ namespace SslEchoServer
             Console.WriteLine("Done!");
 
             // Create and prepare a new SSL server context
-            var context = new SslContext(SslMethod.TLSV12);
-            context.SetPassword("qwerty");
-            context.UseCertificateChainFile("server.pem");
-            context.UsePrivateKeyFile("server.pem", SslFileFormat.PEM);
-            context.UseTmpDHFile("dh4096.pem");
+            var context = CreateContext();
+            var contexts = new List<SslContext>() { context };
+
+            // Rotate session ticket keys
+            System.Threading.Timer rotator = null;
+            if (rotate > 0)
+            {
+                context.RotateSessionTicketKey();
+                rotator = new System.Threading.Timer(state => context.RotateSessionTicketKey(), null, rotate * 1000, rotate * 1000);
+            }
 
             // Create a new echo server
             var server = new EchoServer(service, context, InternetProtocol.IPv4, port);
             // server.SetupNoDelay(true);
             server.SetupReuseAddress(true);
             server.SetupReusePort(true);
+            server.SetupHandshakeLimit(limit);
+            server.SetupSendCoalescing(coalesce, TimeSpan.FromTicks(delay * 10));
+            server.SetupDynamicRecords(dynamic);
+
+            // Reload certificates without dropping connected sessions
+            System.Threading.Timer reloader = null;
+            if (reload > 0)
+            {
+                reloader = new System.Threading.Timer(state =>
+                {
+                    var reloaded = CreateContext();
+                    server.ReplaceContext(reloaded);
+                    lock (contexts)
+                        contexts.Add(reloaded);
+                }, null, reload * 1000, reload * 1000);
+            }
 
             // Start the server
             Console.Write("Server starting...");
@@ -118,6 +186,36 @@ namespace SslEchoServer
             server.Stop();
             Console.WriteLine("Done!");
 
+            rotator?.Dispose();
+            reloader?.Dispose();
+
+            var cpu = Process.GetCurrentProcess().TotalProcessorTime;
+            var sent = Interlocked.Read(ref TotalBytesSent);
+            var encrypted = Interlocked.Read(ref TotalBytesEncrypted);
+            Console.WriteLine($"Plaintext sent: {Service.GenerateDataSize(sent)}");
+            Console.WriteLine($"Encrypted sent: {Service.GenerateDataSize(encrypted)}");
+            if (sent > 0)
+            {
+                Console.WriteLine($"TLS overhead: {(double)(encrypted - sent) / sent:P}");
+                Console.WriteLine($"CPU time per KiB: {Service.GenerateTimePeriod(cpu.TotalMilliseconds * 1024 / sent)}");
+            }
+
+            lock (contexts)
+            {
+                Console.WriteLine($"Certificate reloads: {contexts.Count - 1}");
+                Console.WriteLine($"Full handshakes: {contexts.Sum(c => c.HandshakesFull)}");
+                Console.WriteLine($"Resumed handshakes: {contexts.Sum(c => c.HandshakesResumed)}");
+            }
+            Console.WriteLine($"Rejected handshakes: {server.HandshakesRejected}");
+            Console.WriteLine($"Failed handshakes: {server.HandshakesFailed}");
+            var latency = server.HandshakeLatency;
+            if (latency.Count > 0)
+            {
+                Console.WriteLine($"Handshake latency p50: {Service.GenerateTimePeriod(latency.Percentile(50.0) / 1000000.0)}");
+                Console.WriteLine($"Handshake latency p99: {Service.GenerateTimePeriod(latency.Percentile(99.0) / 1000000.0)}");
+                Console.WriteLine($"Handshake latency max: {Service.GenerateTimePeriod(latency.Max / 1000000.0)}");
+            }
+
             // Stop the service
             Console.Write("Service stopping...");
             service.Stop();
@@ -0,0 +1,206 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Threading;
+using CSharpServer;
+using NDesk.Options;
+
+namespace SslHandshake
+{
+    class HandshakeSession : SslSession
+    {
+        public HandshakeSession(SslServer server) : base(server) {}
+
+        protected override void OnError(int error, string category, string message)
+        {
+            Console.WriteLine($"Session caught an error with code {error} and category '{category}': {message}");
+        }
+    }
+
+    class HandshakeServer : SslServer
+    {
+        public HandshakeServer(Service service, SslContext context, InternetProtocol protocol, int port) : base(service, context, protocol, port) {}
+
+        protected override SslSession CreateSession() { return new HandshakeSession(this); }
+
+        protected override void OnError(int error, string category, string message)
+        {
+            Console.WriteLine($"Server caught an error with code {error} and category '{category}': {message}");
+        }
+    }
+
+    class HandshakeClient : SslClient
+    {
+        public bool Done { get; set; }
+
+        public HandshakeClient(Service service, SslContext context, string address, int port) : base(service, context, address, port) {}
+
+        protected override void OnHandshaked()
+        {
+            // Disconnect right after the handshake
+            DisconnectAsync();
+        }
+
+        protected override void OnDisconnected()
+        {
+            // Reconnect until the configuration benchmark is stopped
+            if (Program.Running)
+                ConnectAsync();
+            else
+                Done = true;
+        }
+
+        protected override void OnError(int error, string category, string message)
+        {
+            Console.WriteLine($"Client caught an error with code {error} and category '{category}': {message}");
+            Interlocked.Increment(ref Program.TotalErrors);
+        }
+    }
+
+    class Configuration
+    {
+        public string Name;
+        public SslProtocolVersion Version;
+        public string Ciphers;
+        public string Groups;
+    }
+
+    class Program
+    {
+        public static volatile bool Running;
+        public static long TotalErrors;
+
+        static readonly List<Configuration> Configurations = new List<Configuration>()
+        {
+            new Configuration { Name = "TLS 1.2 ECDHE-RSA-AES128-GCM-SHA256 P-256", Version = SslProtocolVersion.TLSV12, Ciphers = "ECDHE-RSA-AES128-GCM-SHA256", Groups = "P-256" },
+            new Configuration { Name = "TLS 1.2 ECDHE-RSA-AES128-GCM-SHA256 X25519", Version = SslProtocolVersion.TLSV12, Ciphers = "ECDHE-RSA-AES128-GCM-SHA256", Groups = "X25519" },
+            new Configuration { Name = "TLS 1.2 ECDHE-RSA-AES256-GCM-SHA384 X25519", Version = SslProtocolVersion.TLSV12, Ciphers = "ECDHE-RSA-AES256-GCM-SHA384", Groups = "X25519" },
+            new Configuration { Name = "TLS 1.2 ECDHE-RSA-CHACHA20-POLY1305 X25519", Version = SslProtocolVersion.TLSV12, Ciphers = "ECDHE-RSA-CHACHA20-POLY1305", Groups = "X25519" },
+            new Configuration { Name = "TLS 1.3 TLS_AES_128_GCM_SHA256 P-256", Version = SslProtocolVersion.TLSV13, Ciphers = "TLS_AES_128_GCM_SHA256", Groups = "P-256" },
+            new Configuration { Name = "TLS 1.3 TLS_AES_128_GCM_SHA256 X25519", Version = SslProtocolVersion.TLSV13, Ciphers = "TLS_AES_128_GCM_SHA256", Groups = "X25519" },
+            new Configuration { Name = "TLS 1.3 TLS_CHACHA20_POLY1305_SHA256 X25519", Version = SslProtocolVersion.TLSV13, Ciphers = "TLS_CHACHA20_POLY1305_SHA256", Groups = "X25519" }
+        };
+
+        static void Configure(SslContext context, Configuration configuration)
+        {
+            context.SetProtocolVersions(configuration.Version, configuration.Version);
+            if (configuration.Version == SslProtocolVersion.TLSV13)
+                context.SetCipherSuites(configuration.Ciphers);
+            else
+                context.SetCipherList(configuration.Ciphers);
+            context.SetGroups(configuration.Groups);
+
+            // Measure only full handshakes
+            context.SetSessionCacheMode(SslSessionCacheMode.Off);
+            context.SetSessionTickets(false);
+        }
+
+        static void Main(string[] args)
+        {
+            bool help = false;
+            int port = 2222;
+            int threads = Environment.ProcessorCount;
+            int clients = 100;
+            int seconds = 5;
+
+            var options = new OptionSet()
+            {
+                { "h|?|help",   v => help = v != null },
+                { "p|port=", v => port = int.Parse(v) },
+                { "t|threads=", v => threads = int.Parse(v) },
+                { "c|clients=", v => clients = int.Parse(v) },
+                { "d|duration=", v => seconds = int.Parse(v) }
+            };
+
+            try
+            {
+                options.Parse(args);
+            }
+            catch (OptionException e)
+            {
+                Console.Write("Command line error: ");
+                Console.WriteLine(e.Message);
+                Console.WriteLine("Try `--help' to get usage information.");
+                return;
+            }
+
+            if (help)
+            {
+                Console.WriteLine("Usage:");
+                options.WriteOptionDescriptions(Console.Out);
+                return;
+            }
+
+            Console.WriteLine($"Server port: {port}");
+            Console.WriteLine($"Working threads: {threads}");
+            Console.WriteLine($"Working clients: {clients}");
+            Console.WriteLine($"Duration per configuration: {seconds} seconds");
+
+            // Create a new service
+            var service = new Service(threads);
+
+            // Start the service
+            Console.Write("Service starting...");
+            service.Start();
+            Console.WriteLine("Done!");
+
+            Console.WriteLine();
+
+            foreach (var configuration in Configurations)
+            {
+                // Create and prepare a new SSL server context
+                var serverContext = new SslContext(SslMethod.TLS);
+                serverContext.SetPassword("qwerty");
+                serverContext.UseCertificateChainFile("server.pem");
+                serverContext.UsePrivateKeyFile("server.pem", SslFileFormat.PEM);
+                serverContext.UseTmpDHFile("dh4096.pem");
+                Configure(serverContext, configuration);
+
+                // Create and prepare a new SSL client context
+                var clientContext = new SslContext(SslMethod.TLS);
+                clientContext.SetVerifyMode(SslVerifyMode.VerifyPeer);
+                clientContext.LoadVerifyFile("ca.pem");
+                Configure(clientContext, configuration);
+
+                // Start a new server
+                var server = new HandshakeServer(service, serverContext, InternetProtocol.IPv4, port);
+                server.SetupReuseAddress(true);
+                server.Start();
+
+                // Create and connect clients
+                Running = true;
+                var handshakeClients = new List<HandshakeClient>();
+                for (int i = 0; i < clients; ++i)
+                    handshakeClients.Add(new HandshakeClient(service, clientContext, "127.0.0.1", port));
+
+                var start = DateTime.UtcNow;
+                foreach (var client in handshakeClients)
+                    client.ConnectAsync();
+
+                Thread.Sleep(seconds * 1000);
+
+                // Stop reconnecting and wait for all clients
+                Running = false;
+                var handshakes = serverContext.HandshakesFull;
+                var stop = DateTime.UtcNow;
+                foreach (var client in handshakeClients)
+                {
+                    while (!client.Done)
+                        Thread.Yield();
+                }
+
+                server.Stop();
+
+                Console.WriteLine($"{configuration.Name}: {(long)(handshakes / (stop - start).TotalSeconds)} hs/s, latency {Service.GenerateTimePeriod((stop - start).TotalMilliseconds * clients / Math.Max(handshakes, 1))}");
+            }
+
+            Console.WriteLine();
+
+            Console.WriteLine($"Errors: {TotalErrors}");
+
+            // Stop the service
+            Console.Write("Service stopping...");
+            service.Stop();
+            Console.WriteLine("Done!");
+        }
+    }
+}
@@ -0,0 +1,178 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Threading;
+using CSharpServer;
+using NDesk.Options;
+
+namespace SslReconnectClient
+{
+    class ReconnectClient : SslClient
+    {
+        public bool Done { get; set; }
+
+        public ReconnectClient(Service service, SslContext context, string address, int port, int reconnects) : base(service, context, address, port)
+        {
+            _reconnects = reconnects;
+        }
+
+        protected override void OnHandshaked()
+        {
+            SendAsync(Program.MessageToSend);
+        }
+
+        protected override void OnDisconnected()
+        {
+            // Reconnect until all reconnects are performed
+            if (_reconnects-- > 0)
+                ConnectAsync();
+            else
+                Done = true;
+        }
+
+        protected override void OnReceived(byte[] buffer, long size)
+        {
+            _received += size;
+            if (_received >= Program.MessageToSend.Length)
+            {
+                _received = 0;
+                Interlocked.Increment(ref Program.TotalHandshakes);
+                DisconnectAsync();
+            }
+        }
+
+        protected override void OnError(int error, string category, string message)
+        {
+            Console.WriteLine($"Client caught an error with code {error} and category '{category}': {message}");
+            Interlocked.Increment(ref Program.TotalErrors);
+        }
+
+        private int _reconnects;
+        private long _received;
+    }
+
+    class Program
+    {
+        public static byte[] MessageToSend;
+        public static DateTime TimestampStart;
+        public static DateTime TimestampStop;
+        public static long TotalErrors;
+        public static long TotalHandshakes;
+
+        static void Main(string[] args)
+        {
+            bool help = false;
+            string address = "127.0.0.1";
+            int port = 2222;
+            int threads = Environment.ProcessorCount;
+            int clients = 100;
+            int reconnects = 100;
+            int size = 32;
+            bool reuse = true;
+
+            var options = new OptionSet()
+            {
+                { "h|?|help",   v => help = v != null },
+                { "a|address=", v => address = v },
+                { "p|port=", v => port = int.Parse(v) },
+                { "t|threads=", v => threads = int.Parse(v) },
+                { "c|clients=", v => clients = int.Parse(v) },
+                { "r|reconnects=", v => reconnects = int.Parse(v) },
+                { "s|size=", v => size = int.Parse(v) },
+                { "n|no-reuse", v => reuse = v == null }
+            };
+
+            try
+            {
+                options.Parse(args);
+            }
+            catch (OptionException e)
+            {
+                Console.Write("Command line error: ");
+                Console.WriteLine(e.Message);
+                Console.WriteLine("Try `--help' to get usage information.");
+                return;
+            }
+
+            if (help)
+            {
+                Console.WriteLine("Usage:");
+                options.WriteOptionDescriptions(Console.Out);
+                return;
+            }
+
+            Console.WriteLine($"Server address: {address}");
+            Console.WriteLine($"Server port: {port}");
+            Console.WriteLine($"Working threads: {threads}");
+            Console.WriteLine($"Working clients: {clients}");
+            Console.WriteLine($"Reconnects per client: {reconnects}");
+            Console.WriteLine($"Message size: {size}");
+            Console.WriteLine($"Session reuse: {reuse}");
+
+            // Prepare a message to send
+            MessageToSend = new byte[size];
+
+            // Create a new service
+            var service = new Service(threads);
+
+            // Start the service
+            Console.Write("Service starting...");
+            service.Start();
+            Console.WriteLine("Done!");
+
+            // Create and prepare a new SSL client context
+            var context = new SslContext(SslMethod.TLSV12);
+            context.SetVerifyMode(SslVerifyMode.VerifyPeer);
+            context.LoadVerifyFile("ca.pem");
+            context.SetSessionCacheMode(reuse ? SslSessionCacheMode.Client : SslSessionCacheMode.Off);
+
+            // Create reconnect clients
+            var reconnectClients = new List<ReconnectClient>();
+            for (int i = 0; i < clients; ++i)
+            {
+                var client = new ReconnectClient(service, context, address, port, reconnects);
+                client.SetupSessionReuse(reuse);
+                reconnectClients.Add(client);
+            }
+
+            TimestampStart = DateTime.UtcNow;
+
+            // Connect clients
+            Console.Write("Clients connecting...");
+            foreach (var client in reconnectClients)
+                client.ConnectAsync();
+            Console.WriteLine("Done!");
+
+            // Wait for all reconnects
+            Console.Write("Processing...");
+            foreach (var client in reconnectClients)
+            {
+                while (!client.Done)
+                    Thread.Sleep(100);
+            }
+            Console.WriteLine("Done!");
+
+            TimestampStop = DateTime.UtcNow;
+
+            // Stop the service
+            Console.Write("Service stopping...");
+            service.Stop();
+            Console.WriteLine("Done!");
+
+            Console.WriteLine();
+
+            Console.WriteLine($"Errors: {TotalErrors}");
+
+            Console.WriteLine();
+
+            Console.WriteLine($"Total time: {Service.GenerateTimePeriod((TimestampStop - TimestampStart).TotalMilliseconds)}");
+            Console.WriteLine($"Total handshakes: {TotalHandshakes}");
+            Console.WriteLine($"Full handshakes: {context.HandshakesFull}");
+            Console.WriteLine($"Resumed handshakes: {context.HandshakesResumed}");
+            if (TotalHandshakes > 0)
+            {
+                Console.WriteLine($"Handshake latency: {Service.GenerateTimePeriod((TimestampStop - TimestampStart).TotalMilliseconds / TotalHandshakes)}");
+                Console.WriteLine($"Handshake throughput: {(long)(TotalHandshakes / (TimestampStop - TimestampStart).TotalSeconds)} hs/s");
+            }
+        }
+    }
+}
@@ -0,0 +1,250 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Threading;
+using CSharpServer;
+using NDesk.Options;
+using Performance;
+
+namespace TcpChurn
+{
+    class ChurnSession : TcpSession
+    {
+        public ChurnSession(TcpServer server) : base(server) {}
+
+        protected override void OnReceived(byte[] buffer, long size)
+        {
+            // Resend the message back to the client
+            SendAsync(buffer, 0, size);
+        }
+
+        protected override void OnReset()
+        {
+            // Nothing to reset, the session keeps no per-connection state
+        }
+
+        protected override void OnError(int error, string category, string message)
+        {
+            Console.WriteLine($"Session caught an error with code {error} and category '{category}': {message}");
+        }
+    }
+
+    class ChurnServer : TcpServer
+    {
+        public ChurnServer(Service service, InternetProtocol protocol, int port) : base(service, protocol, port) {}
+
+        protected override TcpSession CreateSession()
+        {
+            Interlocked.Increment(ref Program.TotalSessions);
+            return new ChurnSession(this);
+        }
+
+        protected override void OnError(int error, string category, string message)
+        {
+            Console.WriteLine($"Server caught an error with code {error} and category '{category}': {message}");
+        }
+    }
+
+    class ChurnClient : TcpClient
+    {
+        public bool Done { get; set; }
+
+        public ChurnClient(Service service, string address, int port, int reconnects) : base(service, address, port)
+        {
+            _reconnects = reconnects;
+        }
+
+        protected override void OnConnected()
+        {
+            SendAsync(Program.MessageToSend);
+        }
+
+        protected override void OnDisconnected()
+        {
+            // Reconnect until all reconnects are performed
+            if (_reconnects-- > 0)
+                ConnectAsync();
+            else
+                Done = true;
+        }
+
+        protected override void OnReceived(byte[] buffer, long size)
+        {
+            _received += size;
+            if (_received >= Program.MessageToSend.Length)
+            {
+                _received = 0;
+                Interlocked.Increment(ref Program.TotalConnections);
+                DisconnectAsync();
+            }
+        }
+
+        protected override void OnError(int error, string category, string message)
+        {
+            Console.WriteLine($"Client caught an error with code {error} and category '{category}': {message}");
+            Interlocked.Increment(ref Program.TotalErrors);
+        }
+
+        private int _reconnects;
+        private long _received;
+    }
+
+    class Program
+    {
+        public static byte[] MessageToSend;
+        public static long TotalErrors;
+        public static long TotalConnections;
+        public static long TotalSessions;
+
+        static void Main(string[] args)
+        {
+            bool help = false;
+            string json = null;
+            string address = "127.0.0.1";
+            int port = 1111;
+            int threads = Environment.ProcessorCount;
+            int clients = 100;
+            int reconnects = 1000;
+            int size = 32;
+            int pool = 1000;
+            bool keep = false;
+
+            var options = new OptionSet()
+            {
+                { "h|?|help",   v => help = v != null },
+                { "a|address=", v => address = v },
+                { "p|port=", v => port = int.Parse(v) },
+                { "t|threads=", v => threads = int.Parse(v) },
+                { "c|clients=", v => clients = int.Parse(v) },
+                { "r|reconnects=", v => reconnects = int.Parse(v) },
+                { "s|size=", v => size = int.Parse(v) },
+                { "o|pool=", v => pool = int.Parse(v) },
+                { "k|keep", v => keep = v != null },
+                { "j|json=", v => json = v }
+            };
+
+            try
+            {
+                options.Parse(args);
+            }
+            catch (OptionException e)
+            {
+                Console.Write("Command line error: ");
+                Console.WriteLine(e.Message);
+                Console.WriteLine("Try `--help' to get usage information.");
+                return;
+            }
+
+            if (help)
+            {
+                Console.WriteLine("Usage:");
+                options.WriteOptionDescriptions(Console.Out);
+                return;
+            }
+
+            Console.WriteLine($"Server address: {address}");
+            Console.WriteLine($"Server port: {port}");
+            Console.WriteLine($"Working threads: {threads}");
+            Console.WriteLine($"Working clients: {clients}");
+            Console.WriteLine($"Reconnects per client: {reconnects}");
+            Console.WriteLine($"Message size: {size}");
+            Console.WriteLine($"Session pool: {pool}");
+            Console.WriteLine($"Release on disconnect: {!keep}");
+
+            // Prepare a message to send
+            MessageToSend = new byte[size];
+
+            // Create a new service
+            var service = new Service(threads);
+
+            // Start the service
+            Console.Write("Service starting...");
+            service.Start();
+            Console.WriteLine("Done!");
+
+            // Create and start the churn server with the session pool
+            var server = new ChurnServer(service, InternetProtocol.IPv4, port);
+            server.SetupSessionPool(pool);
+            server.SetupReleaseOnDisconnect(!keep);
+            server.SetupReuseAddress(true);
+            Console.Write("Server starting...");
+            server.Start();
+            Console.WriteLine("Done!");
+
+            // Create churn clients
+            var churnClients = new List<ChurnClient>();
+            for (int i = 0; i < clients; ++i)
+            {
+                var client = new ChurnClient(service, address, port, reconnects);
+                churnClients.Add(client);
+            }
+
+            int gen0 = GC.CollectionCount(0);
+            int gen1 = GC.CollectionCount(1);
+            int gen2 = GC.CollectionCount(2);
+            var timestampStart = DateTime.UtcNow;
+
+            // Connect clients
+            Console.Write("Clients connecting...");
+            foreach (var client in churnClients)
+                client.ConnectAsync();
+            Console.WriteLine("Done!");
+
+            // Wait for all reconnects
+            Console.Write("Processing...");
+            foreach (var client in churnClients)
+            {
+                while (!client.Done)
+                    Thread.Sleep(100);
+            }
+            Console.WriteLine("Done!");
+
+            var timestampStop = DateTime.UtcNow;
+            gen0 = GC.CollectionCount(0) - gen0;
+            gen1 = GC.CollectionCount(1) - gen1;
+            gen2 = GC.CollectionCount(2) - gen2;
+            long heldSessions = server.HeldSessions;
+            long heldMemory = server.HeldMemory;
+
+            // Stop the server
+            Console.Write("Server stopping...");
+            server.Stop();
+            Console.WriteLine("Done!");
+
+            // Stop the service
+            Console.Write("Service stopping...");
+            service.Stop();
+            Console.WriteLine("Done!");
+
+            Console.WriteLine();
+
+            Console.WriteLine($"Errors: {TotalErrors}");
+
+            Console.WriteLine();
+
+            Console.WriteLine($"Total time: {Service.GenerateTimePeriod((timestampStop - timestampStart).TotalMilliseconds)}");
+            Console.WriteLine($"Total connections: {TotalConnections}");
+            Console.WriteLine($"Connection throughput: {(long)(TotalConnections / (timestampStop - timestampStart).TotalSeconds)} conn/s");
+            Console.WriteLine($"Created sessions: {TotalSessions}");
+            Console.WriteLine($"Reused sessions: {server.ReusedSessions}");
+            Console.WriteLine($"Released sessions: {server.ReleasedSessions}");
+            Console.WriteLine($"Held sessions: {heldSessions} ({Service.GenerateDataSize(heldMemory)})");
+            Console.WriteLine($"GC collections: gen0 {gen0}, gen1 {gen1}, gen2 {gen2}");
+
+            // Write machine-readable results
+            if (json != null)
+                JsonReport.Write(json,
+                    "benchmark", "TcpChurn",
+                    "clients", clients,
+                    "reconnects", reconnects,
+                    "pool", pool,
+                    "errors", TotalErrors,
+                    "seconds", (timestampStop - timestampStart).TotalSeconds,
+                    "connections", TotalConnections,
+                    "sessions", TotalSessions,
+                    "reused_sessions", server.ReusedSessions,
+                    "gc0", gen0,
+                    "gc1", gen1,
+                    "gc2", gen2);
+        }
+    }
+}
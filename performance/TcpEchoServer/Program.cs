@@ -6,30 +6,36 @@ namespace TcpEchoServer
 {
     class EchoSession : TcpSession
     {
-        public EchoSession(TcpServer server) : base(server) {}
+        public EchoSession(TcpServer server, int fragments) : base(server) { _fragments = fragments; }
 
         protected override void OnReceived(byte[] buffer, long size)
         {
-            // Resend the message back to the client
-            SendAsync(buffer, 0, size);
+            // Resend the message back to the client in several sends (e.g. header, body and trailer)
+            long fragment = Math.Max(size / _fragments, 1);
+            for (long offset = 0; offset < size; offset += fragment)
+                SendAsync(buffer, offset, Math.Min(fragment, size - offset));
         }
 
         protected override void OnError(int error, string category, string message)
         {
             Console.WriteLine($"Session caught an error with code {error} and category '{category}': {message}");
         }
+
+        private int _fragments;
     }
 
     class EchoServer : TcpServer
     {
-        public EchoServer(Service service, InternetProtocol protocol, int port) : base(service, protocol, port) {}
+        public EchoServer(Service service, InternetProtocol protocol, int port, int fragments) : base(service, protocol, port) { _fragments = fragments; }
 
-        protected override TcpSession CreateSession() { return new EchoSession(this); }
+        protected override TcpSession CreateSession() { return new EchoSession(this, _fragments); }
 
         protected override void OnError(int error, string category, string message)
         {
             Console.WriteLine($"Server caught an error with code {error} and category '{category}': {message}");
         }
+
+        private int _fragments;
     }
 
     class Program
@@ -39,12 +45,24 @@ namespace TcpEchoServer
             bool help = false;
             int port = 1111;
             int threads = Environment.ProcessorCount;
+            int maxSessions = 0;
+            int maxPerAddress = 0;
+            int acceptRate = 0;
+            bool reset = false;
+            int fragments = 1;
+            bool cork = false;
 
             var options = new OptionSet()
             {
                 { "h|?|help",   v => help = v != null },
                 { "p|port=", v => port = int.Parse(v) },
-                { "t|threads=", v => threads = int.Parse(v) }
+                { "t|threads=", v => threads = int.Parse(v) },
+                { "s|sessions=", v => maxSessions = int.Parse(v) },
+                { "a|address=", v => maxPerAddress = int.Parse(v) },
+                { "r|rate=", v => acceptRate = int.Parse(v) },
+                { "x|reset", v => reset = v != null },
+                { "f|fragments=", v => fragments = Math.Max(int.Parse(v), 1) },
+                { "c|cork", v => cork = v != null }
             };
 
             try
@@ -68,6 +86,12 @@ namespace TcpEchoServer
 
             Console.WriteLine($"Server port: {port}");
             Console.WriteLine($"Working threads: {threads}");
+            Console.WriteLine($"Max sessions: {maxSessions}");
+            Console.WriteLine($"Max sessions per address: {maxPerAddress}");
+            Console.WriteLine($"Accept rate: {acceptRate}");
+            Console.WriteLine($"Reset rejected: {reset}");
+            Console.WriteLine($"Echo fragments: {fragments}");
+            Console.WriteLine($"Send corking: {cork}");
 
             // Create a new service
             var service = new Service(threads);
@@ -78,10 +102,15 @@ namespace TcpEchoServer
             Console.WriteLine("Done!");
 
             // Create a new echo server
-            var server = new EchoServer(service, InternetProtocol.IPv4, port);
+            var server = new EchoServer(service, InternetProtocol.IPv4, port, fragments);
             // server.SetupNoDelay(true);
             server.SetupReuseAddress(true);
             server.SetupReusePort(true);
+            server.SetupMaxSessions(maxSessions);
+            server.SetupMaxSessionsPerAddress(maxPerAddress);
+            server.SetupAcceptLimit(acceptRate, acceptRate);
+            server.SetupRejectReset(reset);
+            server.SetupSendCorking(cork, TimeSpan.Zero);
 
             // Start the server
             Console.Write("Server starting...");
@@ -106,6 +135,8 @@ namespace TcpEchoServer
                 }
             }
 
+            Console.WriteLine($"Rejected connections: {server.RejectedConnections} (sessions: {server.RejectedBySessionLimit}, rate: {server.RejectedByAcceptRate}, address: {server.RejectedByAddressLimit})");
+
             // Stop the server
             Console.Write("Server stopping...");
             server.Stop();
@@ -3,6 +3,7 @@ using System.Collections.Generic;
 using System.Threading;
 using CSharpServer;
 using NDesk.Options;
+using Performance;
 
 namespace TcpMulticastClient
 {
@@ -43,6 +44,7 @@ namespace TcpMulticastClient
         static void Main(string[] args)
         {
             bool help = false;
+            string json = null;
             string address = "127.0.0.1";
             int port = 1111;
             int threads = Environment.ProcessorCount;
@@ -56,7 +58,8 @@ namespace TcpMulticastClient
                 { "p|port=", v => port = int.Parse(v) },
                 { "t|threads=", v => threads = int.Parse(v) },
                 { "c|clients=", v => clients = int.Parse(v) },
-                { "s|size=", v => size = int.Parse(v) }
+                { "s|size=", v => size = int.Parse(v) },
+                { "j|json=", v => json = v }
             };
 
             try
@@ -157,6 +160,17 @@ namespace TcpMulticastClient
                 Console.WriteLine($"Message latency: {Service.GenerateTimePeriod((TimestampStop - TimestampStart).TotalMilliseconds / TotalMessages)}");
                 Console.WriteLine($"Message throughput: {(long)(TotalMessages / (TimestampStop - TimestampStart).TotalSeconds)} msg/s");
             }
+
+            // Write machine-readable results
+            if (json != null)
+                JsonReport.Write(json,
+                    "benchmark", "TcpMulticastClient",
+                    "clients", clients,
+                    "size", size,
+                    "errors", TotalErrors,
+                    "seconds", (TimestampStop - TimestampStart).TotalSeconds,
+                    "bytes", TotalBytes,
+                    "messages", TotalMessages);
         }
     }
 }
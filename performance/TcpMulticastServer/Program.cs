@@ -34,6 +34,40 @@ namespace TcpMulticastServer
         }
     }
 
+    class MulticastTimer : CSharpServer.Timer
+    {
+        public MulticastTimer(Service service, MulticastServer server, int messagesRate, int messageSize, int frequency) : base(service)
+        {
+            _server = server;
+            _messagesRate = messagesRate;
+            _frequency = frequency;
+            _message = new byte[messageSize];
+        }
+
+        protected override void OnTimer(bool canceled)
+        {
+            if (canceled)
+                return;
+
+            // Spread the messages rate evenly over timer ticks
+            _tick = (_tick + 1) % _frequency;
+            long count = ((long)_messagesRate * (_tick + 1)) / _frequency - ((long)_messagesRate * _tick) / _frequency;
+            for (long i = 0; i < count; ++i)
+                _server.Multicast(_message);
+        }
+
+        protected override void OnError(int error, string category, string message)
+        {
+            Console.WriteLine($"Timer caught an error with code {error} and category '{category}': {message}");
+        }
+
+        private MulticastServer _server;
+        private int _messagesRate;
+        private int _frequency;
+        private byte[] _message;
+        private int _tick = -1;
+    }
+
     class Program
     {
         static void Main(string[] args)
@@ -43,6 +77,8 @@ namespace TcpMulticastServer
             int threads = Environment.ProcessorCount;
             int messagesRate = 1000000;
             int messageSize = 32;
+            int frequency = 1000;
+            int spin = 0;
 
             var options = new OptionSet()
             {
@@ -50,7 +86,9 @@ namespace TcpMulticastServer
                 { "p|port=", v => port = int.Parse(v) },
                 { "t|threads=", v => threads = int.Parse(v) },
                 { "m|messages=", v => messagesRate = int.Parse(v) },
-                { "s|size=", v => messageSize = int.Parse(v) }
+                { "s|size=", v => messageSize = int.Parse(v) },
+                { "f|frequency=", v => frequency = int.Parse(v) },
+                { "x|spin=", v => spin = int.Parse(v) }
             };
 
             try
@@ -76,6 +114,8 @@ namespace TcpMulticastServer
             Console.WriteLine($"Working threads: {threads}");
             Console.WriteLine($"Messages rate: {messagesRate}");
             Console.WriteLine($"Message size: {messageSize}");
+            Console.WriteLine($"Pacing frequency: {frequency} Hz");
+            Console.WriteLine($"Pacing spin: {spin} us");
 
             // Create a new service
             var service = new Service(threads);
@@ -96,29 +136,10 @@ namespace TcpMulticastServer
             server.Start();
             Console.WriteLine("Done!");
 
-            // Start the multicasting thread
-            bool multicasting = true;
-            var multicaster = Task.Factory.StartNew(() =>
-            {
-                // Prepare message to multicast
-                byte[] message = new byte[messageSize];
-
-                // Multicasting loop
-                while (multicasting)
-                {
-                    var start = DateTime.UtcNow;
-                    for (int i = 0; i < messagesRate; ++i)
-                        server.Multicast(message);
-                    var end = DateTime.UtcNow;
-
-                    // Sleep for remaining time or yield
-                    var milliseconds = (int)(end - start).TotalMilliseconds;
-                    if (milliseconds < 1000)
-                        Thread.Sleep(milliseconds);
-                    else
-                        Thread.Yield();
-                }
-            });
+            // Start the multicasting timer
+            var multicaster = new MulticastTimer(service, server, messagesRate, messageSize, frequency);
+            multicaster.SetupSpin(TimeSpan.FromTicks(spin * 10));
+            multicaster.StartPeriodic(TimeSpan.FromTicks(TimeSpan.TicksPerSecond / frequency), TimerPolicy.Burst);
 
             Console.WriteLine("Press Enter to stop the server or '!' to restart the server...");
 
@@ -138,9 +159,9 @@ namespace TcpMulticastServer
                 }
             }
 
-            // Stop the multicasting thread
-            multicasting = false;
-            multicaster.Wait();
+            // Stop the multicasting timer
+            multicaster.StopPeriodic();
+            Console.WriteLine($"Pacing overruns: {multicaster.Overruns}");
 
             // Stop the server
             Console.Write("Server stopping...");
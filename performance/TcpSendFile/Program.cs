@@ -0,0 +1,277 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.IO;
+using System.Threading;
+using CSharpServer;
+using NDesk.Options;
+using Performance;
+
+namespace TcpSendFile
+{
+    class FileSession : TcpSession
+    {
+        public FileSession(TcpServer server) : base(server) {}
+
+        protected override void OnConnected()
+        {
+            if (Program.Chunked)
+            {
+                _file = new FileStream(Program.FilePath, FileMode.Open, FileAccess.Read, FileShare.Read, Program.ChunkSize, FileOptions.SequentialScan);
+                _buffer = new byte[Program.ChunkSize];
+                SendChunks();
+            }
+            else
+                SendFileAsync(Program.FilePath, 0, Program.FileSize);
+        }
+
+        protected override void OnDisconnected()
+        {
+            lock (this)
+            {
+                _file?.Dispose();
+                _file = null;
+            }
+        }
+
+        protected override void OnSent(long sent, long pending)
+        {
+            if (Program.Chunked)
+                SendChunks();
+        }
+
+        protected override void OnError(int error, string category, string message)
+        {
+            Console.WriteLine($"Session caught an error with code {error} and category '{category}': {message}");
+        }
+
+        private void SendChunks()
+        {
+            lock (this)
+            {
+                // Keep a few chunks in the send buffer instead of the whole file
+                while ((_file != null) && (_sent < Program.FileSize) && (BytesPending < (Program.ChunkSize * 4)))
+                {
+                    int size = _file.Read(_buffer, 0, (int)Math.Min(_buffer.Length, Program.FileSize - _sent));
+                    if (size <= 0)
+                        break;
+
+                    SendAsync(_buffer, 0, size);
+                    _sent += size;
+                }
+            }
+        }
+
+        private FileStream _file;
+        private byte[] _buffer;
+        private long _sent;
+    }
+
+    class FileServer : TcpServer
+    {
+        public FileServer(Service service, InternetProtocol protocol, int port) : base(service, protocol, port) {}
+
+        protected override TcpSession CreateSession() { return new FileSession(this); }
+
+        protected override void OnError(int error, string category, string message)
+        {
+            Console.WriteLine($"Server caught an error with code {error} and category '{category}': {message}");
+        }
+    }
+
+    class FileClient : TcpClient
+    {
+        public ManualResetEvent Done { get; } = new ManualResetEvent(false);
+        public long Received { get; private set; }
+
+        public FileClient(Service service, string address, int port) : base(service, address, port) {}
+
+        protected override void OnReceived(byte[] buffer, long size)
+        {
+            Received += size;
+            if (Received >= Program.FileSize)
+                Done.Set();
+        }
+
+        protected override void OnError(int error, string category, string message)
+        {
+            Console.WriteLine($"Client caught an error with code {error} and category '{category}': {message}");
+            Interlocked.Increment(ref Program.TotalErrors);
+        }
+    }
+
+    class Program
+    {
+        public static string FilePath;
+        public static long FileSize;
+        public static int ChunkSize;
+        public static bool Chunked;
+        public static long TotalErrors;
+
+        static void Main(string[] args)
+        {
+            bool help = false;
+            string json = null;
+            string address = "127.0.0.1";
+            int port = 1111;
+            int threads = Environment.ProcessorCount;
+            string path = null;
+            long size = 1024L * 1024 * 1024;
+            int chunk = 65536;
+            string mode = "both";
+
+            var options = new OptionSet()
+            {
+                { "h|?|help",   v => help = v != null },
+                { "a|address=", v => address = v },
+                { "p|port=", v => port = int.Parse(v) },
+                { "t|threads=", v => threads = int.Parse(v) },
+                { "f|file=", v => path = v },
+                { "s|size=", v => size = long.Parse(v) },
+                { "c|chunk=", v => chunk = int.Parse(v) },
+                { "m|mode=", v => mode = v },
+                { "j|json=", v => json = v }
+            };
+
+            try
+            {
+                options.Parse(args);
+            }
+            catch (OptionException e)
+            {
+                Console.Write("Command line error: ");
+                Console.WriteLine(e.Message);
+                Console.WriteLine("Try `--help' to get usage information.");
+                return;
+            }
+
+            if (help)
+            {
+                Console.WriteLine("Usage:");
+                options.WriteOptionDescriptions(Console.Out);
+                return;
+            }
+
+            // Create a temporary file of the given size if no file is given
+            bool temporary = (path == null);
+            if (temporary)
+            {
+                path = Path.GetTempFileName();
+                Console.Write($"Creating {Service.GenerateDataSize(size)} file...");
+                CreateFile(path, size);
+                Console.WriteLine("Done!");
+            }
+
+            FilePath = path;
+            FileSize = new FileInfo(path).Length;
+            ChunkSize = chunk;
+
+            Console.WriteLine($"Server address: {address}");
+            Console.WriteLine($"Server port: {port}");
+            Console.WriteLine($"Working threads: {threads}");
+            Console.WriteLine($"File: {FilePath}");
+            Console.WriteLine($"File size: {Service.GenerateDataSize(FileSize)}");
+            Console.WriteLine($"Chunk size: {ChunkSize}");
+            Console.WriteLine($"Mode: {mode}");
+
+            // Create a new service
+            var service = new Service(threads);
+
+            // Start the service
+            Console.Write("Service starting...");
+            service.Start();
+            Console.WriteLine("Done!");
+
+            // Create and start the file server
+            var server = new FileServer(service, InternetProtocol.IPv4, port);
+            server.SetupReuseAddress(true);
+            Console.Write("Server starting...");
+            server.Start();
+            Console.WriteLine("Done!");
+
+            var results = new List<object>();
+            if ((mode == "file") || (mode == "both"))
+                results.AddRange(Run(service, address, port, "SendFileAsync", false));
+            if ((mode == "chunked") || (mode == "both"))
+                results.AddRange(Run(service, address, port, "SendAsync", true));
+
+            // Stop the server
+            Console.Write("Server stopping...");
+            server.Stop();
+            Console.WriteLine("Done!");
+
+            // Stop the service
+            Console.Write("Service stopping...");
+            service.Stop();
+            Console.WriteLine("Done!");
+
+            if (temporary)
+                File.Delete(path);
+
+            Console.WriteLine();
+
+            Console.WriteLine($"Errors: {TotalErrors}");
+
+            // Write machine-readable results
+            if (json != null)
+            {
+                results.InsertRange(0, new object[] { "benchmark", "TcpSendFile", "file_size", FileSize, "chunk_size", ChunkSize, "errors", TotalErrors });
+                JsonReport.Write(json, results.ToArray());
+            }
+        }
+
+        static object[] Run(Service service, string address, int port, string name, bool chunked)
+        {
+            Chunked = chunked;
+
+            var client = new FileClient(service, address, port);
+
+            var process = Process.GetCurrentProcess();
+            process.Refresh();
+            TimeSpan cpuStart = process.TotalProcessorTime;
+            int gen0 = GC.CollectionCount(0);
+            int gen2 = GC.CollectionCount(2);
+            var timestampStart = DateTime.UtcNow;
+
+            Console.Write($"{name} transferring...");
+            client.ConnectAsync();
+            client.Done.WaitOne();
+            Console.WriteLine("Done!");
+
+            var timestampStop = DateTime.UtcNow;
+            process.Refresh();
+            TimeSpan cpu = process.TotalProcessorTime - cpuStart;
+            gen0 = GC.CollectionCount(0) - gen0;
+            gen2 = GC.CollectionCount(2) - gen2;
+
+            client.Disconnect();
+
+            double seconds = (timestampStop - timestampStart).TotalSeconds;
+
+            Console.WriteLine();
+
+            Console.WriteLine($"{name}");
+            Console.WriteLine($"Total time: {Service.GenerateTimePeriod((timestampStop - timestampStart).TotalMilliseconds)}");
+            Console.WriteLine($"Total data: {Service.GenerateDataSize(client.Received)}");
+            Console.WriteLine($"Data throughput: {Service.GenerateDataSize((long)(client.Received / seconds))}/s");
+            Console.WriteLine($"CPU time: {Service.GenerateTimePeriod(cpu.TotalMilliseconds)}");
+            Console.WriteLine($"GC collections: gen0 {gen0}, gen2 {gen2}");
+
+            Console.WriteLine();
+
+            string prefix = chunked ? "chunked_" : "file_";
+            return new object[] { prefix + "seconds", seconds, prefix + "cpu_seconds", cpu.TotalSeconds, prefix + "gc0", gen0, prefix + "gc2", gen2 };
+        }
+
+        static void CreateFile(string path, long size)
+        {
+            var buffer = new byte[1024 * 1024];
+            new Random(0).NextBytes(buffer);
+            using (var file = new FileStream(path, FileMode.Create, FileAccess.Write))
+            {
+                for (long written = 0; written < size; written += buffer.Length)
+                    file.Write(buffer, 0, (int)Math.Min(buffer.Length, size - written));
+            }
+        }
+    }
+}
@@ -0,0 +1,141 @@
+﻿using System;
+using System.Diagnostics;
+using System.Threading;
+using CSharpServer;
+using NDesk.Options;
+
+namespace TimerWheelBenchmark
+{
+    class BenchmarkTimerWheel : TimerWheel
+    {
+        public BenchmarkTimerWheel(Service service, TimeSpan resolution) : base(service, resolution) {}
+
+        protected override void OnExpired(long[] handles, long[] data, int count)
+        {
+            Interlocked.Add(ref Program.TotalExpired, count);
+            Interlocked.Increment(ref Program.TotalBatches);
+        }
+    }
+
+    class Program
+    {
+        public static long TotalExpired;
+        public static long TotalBatches;
+
+        static void Main(string[] args)
+        {
+            bool help = false;
+            int threads = Environment.ProcessorCount;
+            int timers = 1000000;
+            int seconds = 10;
+            int timeout = 1000;
+            int cancel = 90;
+            int resolution = 1;
+
+            var options = new OptionSet()
+            {
+                { "h|?|help",   v => help = v != null },
+                { "t|threads=", v => threads = int.Parse(v) },
+                { "n|timers=", v => timers = int.Parse(v) },
+                { "s|seconds=", v => seconds = int.Parse(v) },
+                { "o|timeout=", v => timeout = int.Parse(v) },
+                { "c|cancel=", v => cancel = int.Parse(v) },
+                { "r|resolution=", v => resolution = int.Parse(v) }
+            };
+
+            try
+            {
+                options.Parse(args);
+            }
+            catch (OptionException e)
+            {
+                Console.Write("Command line error: ");
+                Console.WriteLine(e.Message);
+                Console.WriteLine("Try `--help' to get usage information.");
+                return;
+            }
+
+            if (help)
+            {
+                Console.WriteLine("Usage:");
+                options.WriteOptionDescriptions(Console.Out);
+                return;
+            }
+
+            Console.WriteLine($"Working threads: {threads}");
+            Console.WriteLine($"Timers per second: {timers}");
+            Console.WriteLine($"Benchmark duration: {seconds} seconds");
+            Console.WriteLine($"Maximal timeout: {timeout} milliseconds");
+            Console.WriteLine($"Canceled timers: {cancel}%");
+            Console.WriteLine($"Wheel resolution: {resolution} milliseconds");
+
+            // Create a new service
+            var service = new Service(threads);
+
+            // Start the service
+            Console.Write("Service starting...");
+            service.Start();
+            Console.WriteLine("Done!");
+
+            // Create a new timer wheel
+            var wheel = new BenchmarkTimerWheel(service, TimeSpan.FromMilliseconds(resolution));
+
+            var random = new Random();
+            var handles = new long[timers];
+            long scheduled = 0;
+            long canceled = 0;
+
+            Console.Write("Processing...");
+            var stopwatch = Stopwatch.StartNew();
+            var busy = TimeSpan.Zero;
+            for (int second = 0; second < seconds; ++second)
+            {
+                var start = stopwatch.Elapsed;
+
+                // Schedule timers with random timeouts
+                for (int i = 0; i < timers; ++i)
+                    handles[i] = wheel.Schedule(TimeSpan.FromMilliseconds(random.Next(1, timeout)), i);
+                scheduled += timers;
+
+                // Cancel most of them as request timeouts usually do
+                for (int i = 0; i < timers; ++i)
+                {
+                    if (random.Next(100) < cancel)
+                    {
+                        if (wheel.Cancel(handles[i]))
+                            ++canceled;
+                    }
+                }
+
+                var elapsed = stopwatch.Elapsed - start;
+                busy += elapsed;
+
+                // Sleep for the remaining time of the second
+                if (elapsed < TimeSpan.FromSeconds(1))
+                    Thread.Sleep(TimeSpan.FromSeconds(1) - elapsed);
+            }
+            Console.WriteLine("Done!");
+
+            // Wait for all remaining timers
+            Console.Write("Waiting for remaining timers...");
+            while (wheel.Count > 0)
+                Thread.Sleep(100);
+            Console.WriteLine("Done!");
+
+            // Stop the service
+            Console.Write("Service stopping...");
+            service.Stop();
+            Console.WriteLine("Done!");
+
+            Console.WriteLine();
+
+            Console.WriteLine($"Scheduled timers: {scheduled}");
+            Console.WriteLine($"Canceled timers: {canceled}");
+            Console.WriteLine($"Expired timers: {Interlocked.Read(ref TotalExpired)}");
+            Console.WriteLine($"Expiry batches: {Interlocked.Read(ref TotalBatches)}");
+            Console.WriteLine($"Schedule/cancel time: {Service.GenerateTimePeriod(busy.TotalMilliseconds)}");
+            Console.WriteLine($"Schedule/cancel latency: {Service.GenerateTimePeriod(busy.TotalMilliseconds / (scheduled + canceled))}");
+            Console.WriteLine($"Schedule/cancel throughput: {(long)((scheduled + canceled) / busy.TotalSeconds)} ops/s");
+        }
+    }
+}
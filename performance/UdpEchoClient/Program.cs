@@ -3,6 +3,7 @@ using System.Collections.Generic;
 using System.Threading;
 using CSharpServer;
 using NDesk.Options;
+using Performance;
 
 namespace UdpEchoClient
 {
@@ -22,7 +23,8 @@ namespace UdpEchoClient
             // Start receive datagrams
             ReceiveAsync();
 
-            SendMessage();
+            if (Program.Rate == 0)
+                SendMessage();
         }
 
         protected override void OnReceived(UdpEndpoint endpoint, byte[] buffer, long size)
@@ -31,10 +33,14 @@ namespace UdpEchoClient
             Program.TotalBytes += size;
             ++Program.TotalMessages;
 
+            if ((Program.Rate > 0) && (size >= 8))
+                OpenLoop.Record(BitConverter.ToInt64(buffer, 0));
+
             // Continue receive datagrams
             ReceiveAsync();
 
-            SendMessage();
+            if (Program.Rate == 0)
+                SendMessage();
         }
 
         protected override void OnError(int error, string category, string message)
@@ -43,6 +49,19 @@ namespace UdpEchoClient
             ++Program.TotalErrors;
         }
 
+        public void PrepareTimed()
+        {
+            _timedMessage = new byte[Program.MessageToSend.Length];
+        }
+
+        public void SendTimed(long sequence)
+        {
+            // Sequence number in the datagram is used to find its send times
+            for (int i = 0; i < 8; ++i)
+                _timedMessage[i] = (byte)(sequence >> (8 * i));
+            Send(_timedMessage);
+        }
+
         private void SendMessage()
         {
             if (_messages-- > 0)
@@ -51,6 +70,7 @@ namespace UdpEchoClient
                 DisconnectAsync();
         }
 
+        private byte[] _timedMessage;
         private int _messages;
     }
 
@@ -62,16 +82,19 @@ namespace UdpEchoClient
         public static long TotalErrors;
         public static long TotalBytes;
         public static long TotalMessages;
+        public static int Rate;
 
         static void Main(string[] args)
         {
             bool help = false;
+            string json = null;
             string address = "127.0.0.1";
             int port = 3333;
             int threads = Environment.ProcessorCount;
             int clients = 100;
             int messages = 1000000;
             int size = 32;
+            int duration = 10;
 
             var options = new OptionSet()
             {
@@ -81,7 +104,10 @@ namespace UdpEchoClient
                 { "t|threads=", v => threads = int.Parse(v) },
                 { "c|clients=", v => clients = int.Parse(v) },
                 { "m|messages=", v => messages = int.Parse(v) },
-                { "s|size=", v => size = int.Parse(v) }
+                { "s|size=", v => size = int.Parse(v) },
+                { "r|rate=", v => Rate = int.Parse(v) },
+                { "d|duration=", v => duration = int.Parse(v) },
+                { "j|json=", v => json = v }
             };
 
             try
@@ -103,15 +129,29 @@ namespace UdpEchoClient
                 return;
             }
 
+            // Open-loop messages carry 8 bytes of the sequence number
+            if (Rate > 0)
+            {
+                size = Math.Max(size, 8);
+                messages = Rate * duration;
+            }
+
             Console.WriteLine($"Server address: {address}");
             Console.WriteLine($"Server port: {port}");
             Console.WriteLine($"Working threads: {threads}");
             Console.WriteLine($"Working clients: {clients}");
             Console.WriteLine($"Messages to send: {messages}");
             Console.WriteLine($"Message size: {size}");
+            if (Rate > 0)
+            {
+                Console.WriteLine($"Open-loop rate: {Rate} msg/s");
+                Console.WriteLine($"Open-loop duration: {duration} s");
+            }
 
             // Prepare a message to send
             MessageToSend = new byte[size];
+            if (Rate > 0)
+                OpenLoop.Prepare(messages);
 
             // Create a new service
             var service = new Service(threads);
@@ -126,6 +166,8 @@ namespace UdpEchoClient
             for (int i = 0; i < clients; ++i)
             {
                 var client = new EchoClient(service, address, port, messages / clients);
+                if (Rate > 0)
+                    client.PrepareTimed();
                 echoClients.Add(client);
             }
 
@@ -143,6 +185,20 @@ namespace UdpEchoClient
             }
             Console.WriteLine("All clients connected!");
 
+            // Send messages at the fixed rate in open-loop mode
+            if (Rate > 0)
+            {
+                TimestampStart = DateTime.UtcNow;
+                Console.Write("Sending...");
+                OpenLoop.Send(Rate, messages, sequence => echoClients[(int)(sequence % echoClients.Count)].SendTimed(sequence));
+                Console.WriteLine("Done!");
+                Console.Write("Receiving...");
+                OpenLoop.Wait(messages);
+                Console.WriteLine("Done!");
+                foreach (var client in echoClients)
+                    client.DisconnectAsync();
+            }
+
             // Wait for processing all messages
             Console.Write("Processing...");
             foreach (var client in echoClients)
@@ -172,6 +228,30 @@ namespace UdpEchoClient
                 Console.WriteLine($"Message latency: {Service.GenerateTimePeriod((TimestampStop - TimestampStart).TotalMilliseconds / TotalMessages)}");
                 Console.WriteLine($"Message throughput: {(long)(TotalMessages / (TimestampStop - TimestampStart).TotalSeconds)} msg/s");
             }
+
+            if (Rate > 0)
+            {
+                Console.WriteLine();
+
+                OpenLoop.Print();
+            }
+
+            // Write machine-readable results
+            if (json != null)
+                JsonReport.Write(json,
+                    "benchmark", "UdpEchoClient",
+                    "clients", clients,
+                    "size", size,
+                    "rate", Rate,
+                    "errors", TotalErrors,
+                    "seconds", (TimestampStop - TimestampStart).TotalSeconds,
+                    "bytes", TotalBytes,
+                    "messages", TotalMessages,
+                    "outstanding", OpenLoop.Outstanding,
+                    "latency_p50_ns", OpenLoop.Latency.Percentile(50.0),
+                    "latency_p99_ns", OpenLoop.Latency.Percentile(99.0),
+                    "latency_p999_ns", OpenLoop.Latency.Percentile(99.9),
+                    "latency_max_ns", OpenLoop.Latency.Max);
         }
     }
 }
@@ -3,6 +3,7 @@ using System.Collections.Generic;
 using System.Threading;
 using CSharpServer;
 using NDesk.Options;
+using Performance;
 
 namespace UdpMulticastClient
 {
@@ -54,6 +55,7 @@ namespace UdpMulticastClient
         static void Main(string[] args)
         {
             bool help = false;
+            string json = null;
             string address = "239.255.0.1";
             int port = 3333;
             int threads = Environment.ProcessorCount;
@@ -67,7 +69,8 @@ namespace UdpMulticastClient
                 { "p|port=", v => port = int.Parse(v) },
                 { "t|threads=", v => threads = int.Parse(v) },
                 { "c|clients=", v => clients = int.Parse(v) },
-                { "s|size=", v => size = int.Parse(v) }
+                { "s|size=", v => size = int.Parse(v) },
+                { "j|json=", v => json = v }
             };
 
             try
@@ -168,6 +171,17 @@ namespace UdpMulticastClient
                 Console.WriteLine($"Message latency: {Service.GenerateTimePeriod((TimestampStop - TimestampStart).TotalMilliseconds / TotalMessages)}");
                 Console.WriteLine($"Message throughput: {(long)(TotalMessages / (TimestampStop - TimestampStart).TotalSeconds)} msg/s");
             }
+
+            // Write machine-readable results
+            if (json != null)
+                JsonReport.Write(json,
+                    "benchmark", "UdpMulticastClient",
+                    "clients", clients,
+                    "size", size,
+                    "errors", TotalErrors,
+                    "seconds", (TimestampStop - TimestampStart).TotalSeconds,
+                    "bytes", TotalBytes,
+                    "messages", TotalMessages);
         }
     }
 }
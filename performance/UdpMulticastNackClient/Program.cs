@@ -0,0 +1,216 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Threading;
+using CSharpServer;
+using NDesk.Options;
+
+namespace UdpMulticastNackClient
+{
+    class MulticastClient : UdpClient
+    {
+        public bool Connected { get; set; }
+        public string Multicast { get; set; }
+
+        public MulticastClient(Service service, string address, string multicast, int port, double loss) : base(service, address, port)
+        {
+            Multicast = multicast;
+
+            // Drop received datagrams to exercise NACK recovery
+            SetupLossSimulation(loss);
+        }
+
+        protected override void OnConnected()
+        {
+            Connected = true;
+
+            // Join UDP multicast group
+            JoinMulticastGroup(Multicast);
+
+            // Start receive datagrams
+            ReceiveAsync();
+        }
+
+        protected override void OnReceived(UdpEndpoint endpoint, byte[] buffer, long size)
+        {
+            Interlocked.Add(ref Program.TotalBytes, size);
+
+            // Continue receive datagrams
+            ReceiveAsync();
+        }
+
+        protected override void OnMulticastLoss(long sequence, long count)
+        {
+            Interlocked.Add(ref Program.TotalLost, count);
+        }
+
+        protected override void OnError(int error, string category, string message)
+        {
+            Console.WriteLine($"Client caught an error with code {error} and category '{category}': {message}");
+            ++Program.TotalErrors;
+        }
+    }
+
+    class Program
+    {
+        public static byte[] MessageToSend;
+        public static DateTime TimestampStart;
+        public static DateTime TimestampStop;
+        public static long TotalErrors;
+        public static long TotalBytes;
+        public static long TotalMessages;
+        public static long TotalLost;
+
+        static void Main(string[] args)
+        {
+            bool help = false;
+            string address = "239.255.0.1";
+            int port = 3333;
+            int threads = Environment.ProcessorCount;
+            int clients = 1;
+            int size = 32;
+            double loss = 0.01;
+            int timeout = 10;
+            int retries = 3;
+            int reorder = 4096;
+
+            var options = new OptionSet()
+            {
+                { "h|?|help",   v => help = v != null },
+                { "a|address=", v => address = v },
+                { "p|port=", v => port = int.Parse(v) },
+                { "t|threads=", v => threads = int.Parse(v) },
+                { "c|clients=", v => clients = int.Parse(v) },
+                { "s|size=", v => size = int.Parse(v) },
+                { "l|loss=", v => loss = double.Parse(v) },
+                { "n|timeout=", v => timeout = int.Parse(v) },
+                { "r|retries=", v => retries = int.Parse(v) },
+                { "o|reorder=", v => reorder = int.Parse(v) }
+            };
+
+            try
+            {
+                options.Parse(args);
+            }
+            catch (OptionException e)
+            {
+                Console.Write("Command line error: ");
+                Console.WriteLine(e.Message);
+                Console.WriteLine("Try `--help' to get usage information.");
+                return;
+            }
+
+            if (help)
+            {
+                Console.WriteLine("Usage:");
+                options.WriteOptionDescriptions(Console.Out);
+                return;
+            }
+
+            Console.WriteLine($"Server address: {address}");
+            Console.WriteLine($"Server port: {port}");
+            Console.WriteLine($"Working threads: {threads}");
+            Console.WriteLine($"Working clients: {clients}");
+            Console.WriteLine($"Message size: {size}");
+            Console.WriteLine($"Simulated loss: {loss:P}");
+            Console.WriteLine($"NACK timeout: {timeout} ms");
+            Console.WriteLine($"NACK retries: {retries}");
+            Console.WriteLine($"Reorder buffer: {reorder}");
+
+            // Prepare a message to send
+            MessageToSend = new byte[size];
+
+            // Create a new service
+            var service = new Service(threads);
+
+            // Start the service
+            Console.Write("Service starting...");
+            service.Start();
+            Console.WriteLine("Done!");
+
+            // Create multicast clients
+            var multicastClients = new List<MulticastClient>();
+            for (int i = 0; i < clients; ++i)
+            {
+                var client = new MulticastClient(service, "0.0.0.0", address, port, loss);
+                client.SetupMulticast(true);
+                client.SetupMulticastSequencing(true);
+                client.SetupNackTimeout(TimeSpan.FromMilliseconds(timeout));
+                client.SetupNackRetries(retries);
+                client.SetupReorderBuffer(reorder);
+                multicastClients.Add(client);
+            }
+
+            TimestampStart = DateTime.UtcNow;
+
+            // Connect clients
+            Console.Write("Clients connecting...");
+            foreach (var client in multicastClients)
+                client.ConnectAsync();
+            Console.WriteLine("Done!");
+            foreach (var client in multicastClients)
+            {
+                while (!client.Connected)
+                    Thread.Yield();
+            }
+            Console.WriteLine("All clients connected!");
+
+            // Sleep for 10 seconds...
+            Console.Write("Processing...");
+            Thread.Sleep(10000);
+            Console.WriteLine("Done!");
+
+            // Disconnect clients
+            Console.Write("Clients disconnecting...");
+            foreach (var client in multicastClients)
+                client.DisconnectAsync();
+            Console.WriteLine("Done!");
+            foreach (var client in multicastClients)
+                while (client.IsConnected)
+                    Thread.Yield();
+            Console.WriteLine("All clients disconnected!");
+
+            TimestampStop = DateTime.UtcNow;
+
+            long gaps = 0, nacks = 0, recovered = 0, duplicates = 0, dropped = 0;
+            foreach (var client in multicastClients)
+            {
+                gaps += client.MulticastGaps;
+                nacks += client.MulticastNacks;
+                recovered += client.MulticastRecovered;
+                duplicates += client.MulticastDuplicates;
+                dropped += client.MulticastDropped;
+            }
+
+            // Stop the service
+            Console.Write("Service stopping...");
+            service.Stop();
+            Console.WriteLine("Done!");
+
+            Console.WriteLine();
+
+            Console.WriteLine($"Errors: {TotalErrors}");
+            Console.WriteLine($"Dropped: {dropped}");
+            Console.WriteLine($"Gaps: {gaps}");
+            Console.WriteLine($"NACKs: {nacks}");
+            Console.WriteLine($"Recovered: {recovered}");
+            Console.WriteLine($"Lost: {TotalLost}");
+            Console.WriteLine($"Duplicates: {duplicates}");
+
+            Console.WriteLine();
+
+            TotalMessages = TotalBytes / size;
+
+            Console.WriteLine($"Multicast time: {Service.GenerateTimePeriod((TimestampStop - TimestampStart).TotalMilliseconds)}");
+            Console.WriteLine($"Total data: {Service.GenerateDataSize(TotalBytes)}");
+            Console.WriteLine($"Total messages: {TotalMessages}");
+            Console.WriteLine($"Data throughput: {Service.GenerateDataSize((long)(TotalBytes / (TimestampStop - TimestampStart).TotalSeconds))}/s");
+            if (TotalMessages > 0)
+            {
+                Console.WriteLine($"Message latency: {Service.GenerateTimePeriod((TimestampStop - TimestampStart).TotalMilliseconds / TotalMessages)}");
+                Console.WriteLine($"Message throughput: {(long)(TotalMessages / (TimestampStop - TimestampStart).TotalSeconds)} msg/s");
+            }
+            if (dropped > 0)
+                Console.WriteLine($"Recovery ratio: {(double)recovered / dropped:P}");
+        }
+    }
+}
@@ -26,6 +26,8 @@ namespace UdpMulticastServer
             int threads = Environment.ProcessorCount;
             int messagesRate = 1000000;
             int messageSize = 32;
+            bool sequencing = false;
+            int retransmitBuffer = 16384;
 
             var options = new OptionSet()
             {
@@ -34,7 +36,9 @@ namespace UdpMulticastServer
                 { "p|port=", v => port = int.Parse(v) },
                 { "t|threads=", v => threads = int.Parse(v) },
                 { "m|messages=", v => messagesRate = int.Parse(v) },
-                { "s|size=", v => messageSize = int.Parse(v) }
+                { "s|size=", v => messageSize = int.Parse(v) },
+                { "q|sequencing", v => sequencing = v != null },
+                { "r|retransmit=", v => retransmitBuffer = int.Parse(v) }
             };
 
             try
@@ -61,6 +65,9 @@ namespace UdpMulticastServer
             Console.WriteLine($"Working threads: {threads}");
             Console.WriteLine($"Messages rate: {messagesRate}");
             Console.WriteLine($"Message size: {messageSize}");
+            Console.WriteLine($"Multicast sequencing: {sequencing}");
+            if (sequencing)
+                Console.WriteLine($"Retransmit buffer: {retransmitBuffer}");
 
             // Create a new service
             var service = new Service(threads);
@@ -74,6 +81,8 @@ namespace UdpMulticastServer
             var server = new MulticastServer(service, InternetProtocol.IPv4, 0);
             server.SetupReuseAddress(true);
             server.SetupReusePort(true);
+            server.SetupMulticastSequencing(sequencing);
+            server.SetupRetransmitBuffer(retransmitBuffer);
 
             // Start the server
             Console.Write("Server starting...");
@@ -126,6 +135,16 @@ namespace UdpMulticastServer
             multicasting = false;
             multicaster.Wait();
 
+            if (sequencing)
+            {
+                Console.WriteLine();
+                Console.WriteLine($"Multicasted sequences: {server.MulticastSequence}");
+                Console.WriteLine($"Retransmit requests: {server.RetransmitRequests}");
+                Console.WriteLine($"Retransmitted datagrams: {server.RetransmittedDatagrams}");
+                Console.WriteLine($"Retransmit misses: {server.RetransmitMisses}");
+                Console.WriteLine();
+            }
+
             // Stop the server
             Console.Write("Server stopping...");
             server.Stop();
@@ -0,0 +1,171 @@
+#include "stdafx.h"
+
+#include "Cork.h"
+
+namespace CSharpServer {
+
+    void SendCorkEx::Attach(const std::shared_ptr<asio::io_service>& service, const std::weak_ptr<void>& owner, const Writer& writer, size_t size, std::chrono::nanoseconds delay, bool scoped)
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        // Timer is bound to the service of the previous connection
+        if (_service != service)
+            _timer.reset();
+
+        _service = service;
+        _owner = owner;
+        _writer = writer;
+        _size = ((size > 0) && (size < MaxSize)) ? size : MaxSize;
+        _delay = delay;
+        _scoped = scoped;
+        _failed = false;
+        _buffer.reserve(_size);
+        _enabled.store(true, std::memory_order_release);
+    }
+
+    void SendCorkEx::Detach()
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        _enabled.store(false, std::memory_order_release);
+
+        // Drop corked data which cannot be sent anymore
+        if (_armed)
+        {
+            _armed = false;
+            _timer->cancel();
+        }
+        _buffer.clear();
+        _pending = 0;
+    }
+
+    bool SendCorkEx::Send(const void* buffer, size_t size)
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        if (!enabled() || _failed)
+            return false;
+
+        // Large send goes straight into the socket when nothing is corked
+        if (_buffer.empty() && (size >= _size))
+            return _writer(buffer, size);
+
+        const uint8_t* bytes = (const uint8_t*)buffer;
+        _buffer.insert(_buffer.end(), bytes, bytes + size);
+        _pending = _buffer.size();
+
+        // Write the full cork immediately
+        if (_buffer.size() >= _size)
+            return FlushCorked();
+
+        // Sends of the user callback are written when the callback returns
+        if ((_depth > 0) && (_thread == std::this_thread::get_id()))
+            return true;
+
+        // Sends from other threads wait for more data up to the max delay
+        if (_delay.count() > 0)
+        {
+            ArmTimer();
+            return true;
+        }
+
+        return FlushCorked();
+    }
+
+    bool SendCorkEx::Flush()
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+        return !_failed && FlushCorked();
+    }
+
+    bool SendCorkEx::Enter()
+    {
+        if (!enabled())
+            return false;
+
+        std::lock_guard<std::mutex> locker(_lock);
+
+        if (!_scoped)
+            return false;
+
+        if (_depth++ == 0)
+            _thread = std::this_thread::get_id();
+        return true;
+    }
+
+    void SendCorkEx::Leave()
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        if ((_depth > 0) && (--_depth == 0))
+        {
+            _thread = std::thread::id();
+            FlushDeferred();
+        }
+    }
+
+    bool SendCorkEx::FlushCorked()
+    {
+        if (_armed)
+        {
+            _armed = false;
+            _timer->cancel();
+        }
+
+        if (_buffer.empty())
+            return false;
+
+        bool result = _writer(_buffer.data(), _buffer.size());
+
+        // Release the buffer grown by the large send over the cork size
+        if (_buffer.capacity() > _size)
+        {
+            std::vector<uint8_t>().swap(_buffer);
+            _buffer.reserve(_size);
+        }
+        else
+            _buffer.clear();
+        _pending = 0;
+        return result;
+    }
+
+    void SendCorkEx::FlushDeferred()
+    {
+        if (!_buffer.empty() && !FlushCorked())
+            _failed = true;
+    }
+
+    void SendCorkEx::ArmTimer()
+    {
+        if (_armed)
+            return;
+
+        // Write at once if the owner is already gone
+        auto owner = _owner.lock();
+        if (!owner)
+        {
+            FlushDeferred();
+            return;
+        }
+
+        if (!_timer)
+            _timer = std::make_shared<asio::steady_timer>(*_service);
+
+        _armed = true;
+        _timer->expires_from_now(_delay);
+
+        _timer->async_wait([this, owner](const std::error_code& ec)
+        {
+            if (ec == asio::error::operation_aborted)
+                return;
+
+            std::lock_guard<std::mutex> locker(_lock);
+            if (!_armed)
+                return;
+
+            _armed = false;
+            FlushDeferred();
+        });
+    }
+
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "Service.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace CSharpServer {
+
+    //! Send cork
+    /*!
+        Accumulates small sends of the session or client and writes them into
+        the socket with a single send. Sends issued by a user callback on the
+        service thread are corked until the callback returns (see Scope), sends
+        from other threads are corked up to the max delay (zero delay writes
+        them at once). Corked data is written earlier once it reaches the cork
+        size or with the explicit Flush(), sends of the cork size or larger
+        skip the empty cork. A failed write of corked data when the callback
+        returns or the delay expires fails all further sends of the connection.
+
+        Thread-safe.
+    */
+    class SendCorkEx
+    {
+    public:
+        //! Writer of the corked data into the socket
+        typedef std::function<bool(const void*, size_t)> Writer;
+
+        //! Corked scope of the user callback
+        class Scope
+        {
+        public:
+            explicit Scope(SendCorkEx& cork) : _cork(cork), _entered(cork.Enter()) {}
+            Scope(const Scope&) = delete;
+            Scope(Scope&&) = delete;
+            ~Scope() { if (_entered) _cork.Leave(); }
+
+            Scope& operator=(const Scope&) = delete;
+            Scope& operator=(Scope&&) = delete;
+
+        private:
+            SendCorkEx& _cork;
+            bool _entered;
+        };
+
+        SendCorkEx() = default;
+        SendCorkEx(const SendCorkEx&) = delete;
+        SendCorkEx(SendCorkEx&&) = delete;
+        ~SendCorkEx() = default;
+
+        SendCorkEx& operator=(const SendCorkEx&) = delete;
+        SendCorkEx& operator=(SendCorkEx&&) = delete;
+
+        bool enabled() const noexcept { return _enabled.load(std::memory_order_acquire); }
+        //! Get the number of corked bytes waiting to be written
+        size_t pending() const noexcept { return _pending.load(std::memory_order_relaxed); }
+
+        //! Attach the cork to the connected session or client
+        /*!
+            \param service - Asio service of the owner
+            \param owner - Owner of the cork (kept alive while the delay timer is armed)
+            \param writer - Writer of the corked data
+            \param size - Cork size (0 - up to 64 KiB)
+            \param delay - Max delay of sends from other threads (0 - write them at once)
+            \param scoped - Cork sends of user callbacks until the callback returns
+        */
+        void Attach(const std::shared_ptr<asio::io_service>& service, const std::weak_ptr<void>& owner, const Writer& writer, size_t size, std::chrono::nanoseconds delay, bool scoped);
+        //! Detach the cork from the disconnected owner and drop corked data
+        void Detach();
+
+        //! Send data through the cork
+        /*!
+            \param buffer - Buffer to send
+            \param size - Buffer size
+            \return 'true' if the data was corked or written, 'false' if the cork is detached or the write failed
+        */
+        bool Send(const void* buffer, size_t size);
+        //! Write all corked data
+        /*!
+            \return 'true' if corked data was written, 'false' if there was nothing to write or the write failed
+        */
+        bool Flush();
+
+    private:
+        static const size_t MaxSize = 65536;
+
+        std::mutex _lock;
+        std::atomic<bool> _enabled{false};
+        std::shared_ptr<asio::io_service> _service;
+        std::weak_ptr<void> _owner;
+        Writer _writer;
+        size_t _size{0};
+        std::chrono::nanoseconds _delay{0};
+        bool _scoped{false};
+        std::thread::id _thread;
+        int _depth{0};
+        std::vector<uint8_t> _buffer;
+        std::atomic<size_t> _pending{0};
+        bool _failed{false};
+        std::shared_ptr<asio::steady_timer> _timer;
+        bool _armed{false};
+
+        //! Enter the corked scope on the current thread
+        bool Enter();
+        //! Leave the corked scope and write corked data at the outermost scope
+        void Leave();
+        bool FlushCorked();
+        //! Write corked data out of the send call and remember the failed write
+        void FlushDeferred();
+        void ArmTimer();
+    };
+
+}
@@ -0,0 +1,192 @@
+#include "stdafx.h"
+
+#include "Service.h"
+
+namespace CSharpServer {
+
+    //! Interned error
+    struct InternedErrorEx
+    {
+        size_t hash;
+        int code;
+        uint32_t index;
+        std::string category;
+        std::string message;
+    };
+
+    static const size_t MaxInternedErrors = 4096;
+    static const size_t InternedSlots = 2 * MaxInternedErrors;
+
+    // Interned errors are never removed, so published entries are looked up
+    // without the lock and only interning of a new error takes it
+    static std::mutex InternedLock;
+    static uint32_t InternedCount = 1;
+    static std::atomic<InternedErrorEx*> InternedIndex[InternedSlots];
+    static std::atomic<InternedErrorEx*> InternedErrors[MaxInternedErrors];
+
+    static InternedErrorEx* InternedFind(const std::string& category, int code, size_t hash, size_t& slot) noexcept
+    {
+        // Open addressing table is at most half full, so probing always ends at an empty slot
+        for (size_t i = 0; i < InternedSlots; ++i)
+        {
+            slot = (hash + i) & (InternedSlots - 1);
+            InternedErrorEx* interned = InternedIndex[slot].load(std::memory_order_acquire);
+            if ((interned == nullptr) || ((interned->hash == hash) && (interned->code == code) && (interned->category == category)))
+                return interned;
+        }
+        return nullptr;
+    }
+
+    static const char* CategoryNames[] = { "system", "misc", "netdb", "addrinfo", "ssl", "other" };
+
+    bool ErrorsEx::Report(const std::string& category, int code, const std::string& message, ErrorReportEx& report, ErrorAggregatesEx& aggregates)
+    {
+        report.category = Category(category);
+        report.code = code;
+        report.message = 0;
+        report.count = 1;
+
+        _errors[report.category].fetch_add(1, std::memory_order_relaxed);
+
+        int64_t interval = _option_aggregation;
+        if (interval <= 0)
+        {
+            report.message = Intern(category, code, message);
+            return true;
+        }
+
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        uint64_t key = ((uint64_t)report.category << 32) | (uint32_t)code;
+
+        std::lock_guard<std::mutex> locker(aggregates._lock);
+
+        auto it = aggregates._aggregates.find(key);
+        if ((it != aggregates._aggregates.end()) && ((now - it->second.reported) < interval))
+        {
+            ++it->second.suppressed;
+            ++_suppressed;
+            return false;
+        }
+
+        report.message = Intern(category, code, message);
+
+        if (it != aggregates._aggregates.end())
+        {
+            report.count += it->second.suppressed;
+            it->second = ErrorAggregatesEx::Aggregate{ now, 0, report.message };
+            return true;
+        }
+
+        // Forget errors which are not repeated within the interval, but keep
+        // repeats which are still waiting for their report
+        if (aggregates._aggregates.size() >= ErrorAggregatesEx::MaxAggregates)
+        {
+            for (auto it = aggregates._aggregates.begin(); it != aggregates._aggregates.end();)
+            {
+                if (((now - it->second.reported) >= interval) && (it->second.suppressed == 0))
+                    it = aggregates._aggregates.erase(it);
+                else
+                    ++it;
+            }
+        }
+
+        if (aggregates._aggregates.size() < ErrorAggregatesEx::MaxAggregates)
+            aggregates._aggregates.emplace(key, ErrorAggregatesEx::Aggregate{ now, 0, report.message });
+        return true;
+    }
+
+    void ErrorsEx::Flush(ErrorAggregatesEx& aggregates, std::vector<ErrorReportEx>& reports)
+    {
+        std::lock_guard<std::mutex> locker(aggregates._lock);
+
+        for (auto& aggregate : aggregates._aggregates)
+        {
+            if (aggregate.second.suppressed > 0)
+                reports.push_back(ErrorReportEx{ (int)(aggregate.first >> 32), (int)(uint32_t)aggregate.first, aggregate.second.message, aggregate.second.suppressed });
+        }
+        aggregates._aggregates.clear();
+    }
+
+    void ErrorsEx::Describe(const std::string& category, int code, const std::string& message, ErrorReportEx& report)
+    {
+        report.category = Category(category);
+        report.code = code;
+        report.message = Intern(category, code, message);
+        report.count = 1;
+    }
+
+    int ErrorsEx::Category(const std::string& category) noexcept
+    {
+        if (category == "asio.system")
+            return (int)ErrorCategory::System;
+        if (category == "asio.misc")
+            return (int)ErrorCategory::Misc;
+        if (category == "asio.netdb")
+            return (int)ErrorCategory::Netdb;
+        if (category == "asio.addrinfo")
+            return (int)ErrorCategory::Addrinfo;
+        // SSL errors come from 'asio.ssl' and 'asio.ssl.stream' categories
+        if (category.compare(0, 8, "asio.ssl") == 0)
+            return (int)ErrorCategory::Ssl;
+        return (int)ErrorCategory::Other;
+    }
+
+    const char* ErrorsEx::CategoryName(int category) noexcept
+    {
+        return ((category >= 0) && (category < (int)Categories)) ? CategoryNames[category] : CategoryNames[Categories - 1];
+    }
+
+    uint32_t ErrorsEx::Intern(const std::string& category, int code, const std::string& message)
+    {
+        size_t hash = std::hash<std::string>()(category) ^ ((size_t)(uint32_t)code * 2654435761u);
+        size_t slot;
+
+        InternedErrorEx* interned = InternedFind(category, code, hash, slot);
+        if (interned != nullptr)
+            return interned->index;
+
+        std::lock_guard<std::mutex> locker(InternedLock);
+
+        // Another thread could intern the same error before the lock
+        interned = InternedFind(category, code, hash, slot);
+        if (interned != nullptr)
+            return interned->index;
+
+        // Index zero is reserved for the unknown error
+        if (InternedCount >= MaxInternedErrors)
+            return 0;
+
+        interned = new InternedErrorEx{ hash, code, InternedCount++, category, message };
+        InternedErrors[interned->index].store(interned, std::memory_order_release);
+        InternedIndex[slot].store(interned, std::memory_order_release);
+        return interned->index;
+    }
+
+    std::string ErrorsEx::InternedCategory(uint32_t index)
+    {
+        InternedErrorEx* interned = (index < MaxInternedErrors) ? InternedErrors[index].load(std::memory_order_acquire) : nullptr;
+        return (interned != nullptr) ? interned->category : std::string();
+    }
+
+    std::string ErrorsEx::InternedMessage(uint32_t index)
+    {
+        InternedErrorEx* interned = (index < MaxInternedErrors) ? InternedErrors[index].load(std::memory_order_acquire) : nullptr;
+        return (interned != nullptr) ? interned->message : std::string();
+    }
+
+    String^ ErrorInfo::CategoryName::get()
+    {
+        return marshal_as<String^>(ErrorsEx::InternedCategory(_message));
+    }
+
+    String^ ErrorInfo::Message::get()
+    {
+        return marshal_as<String^>(ErrorsEx::InternedMessage(_message));
+    }
+
+    String^ ErrorInfo::ToString()
+    {
+        return String::Format("{0} error {1}: {2}", CategoryName, _code, Message);
+    }
+
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace System;
+
+namespace CSharpServer {
+
+    //! Error category
+    public enum class ErrorCategory
+    {
+        System,         //!< Operating system error ('asio.system')
+        Misc,           //!< Miscellaneous error, e.g. end of file ('asio.misc')
+        Netdb,          //!< Host resolution error ('asio.netdb')
+        Addrinfo,       //!< Address info error ('asio.addrinfo')
+        Ssl,            //!< SSL error ('asio.ssl')
+        Other           //!< Other error category
+    };
+
+    //! Error report
+    struct ErrorReportEx
+    {
+        int category;
+        int code;
+        uint32_t message;
+        uint64_t count;
+    };
+
+    //! Error aggregates
+    /*!
+        Identical errors collapsed within the aggregation interval. Sessions keep
+        their own aggregates, so repeated errors of a session are reported to the
+        session itself and not to other sessions of the server.
+
+        Thread-safe.
+    */
+    class ErrorAggregatesEx
+    {
+    public:
+        ErrorAggregatesEx() = default;
+        ErrorAggregatesEx(const ErrorAggregatesEx&) = delete;
+        ErrorAggregatesEx(ErrorAggregatesEx&&) = delete;
+        ~ErrorAggregatesEx() = default;
+
+        ErrorAggregatesEx& operator=(const ErrorAggregatesEx&) = delete;
+        ErrorAggregatesEx& operator=(ErrorAggregatesEx&&) = delete;
+
+    private:
+        friend class ErrorsEx;
+
+        static const size_t MaxAggregates = 1024;
+
+        struct Aggregate
+        {
+            int64_t reported;
+            uint64_t suppressed;
+            uint32_t message;
+        };
+
+        std::mutex _lock;
+        std::map<uint64_t, Aggregate> _aggregates;
+    };
+
+    //! Error accounting
+    /*!
+        Counts errors by category and optionally collapses repeated identical
+        errors (the same category and code) reported within the aggregation
+        interval into a single report with the repeat count. Repeats which are
+        still waiting for their report are flushed when the owner disconnects
+        or stops. Error category name and message are interned once per distinct
+        error, so reports carry only the index of the interned message.
+
+        Thread-safe.
+    */
+    class ErrorsEx
+    {
+    public:
+        static const size_t Categories = 6;
+
+        ErrorsEx() = default;
+        ErrorsEx(const ErrorsEx&) = delete;
+        ErrorsEx(ErrorsEx&&) = delete;
+        ~ErrorsEx() = default;
+
+        ErrorsEx& operator=(const ErrorsEx&) = delete;
+        ErrorsEx& operator=(ErrorsEx&&) = delete;
+
+        uint64_t errors(int category) const noexcept { return ((category >= 0) && (category < (int)Categories)) ? _errors[category].load() : 0; }
+        uint64_t suppressed() const noexcept { return _suppressed; }
+        int64_t option_aggregation() const noexcept { return _option_aggregation; }
+
+        //! Setup the aggregation interval in nanoseconds (zero to report every error)
+        void SetupAggregation(int64_t interval) noexcept { _option_aggregation = interval; }
+
+        //! Account the error and prepare its report
+        /*!
+            \param category - Error category name
+            \param code - Error code
+            \param message - Error message
+            \param report - Error report
+            \return 'true' if the error should be reported, 'false' if it is collapsed into the next report
+        */
+        bool Report(const std::string& category, int code, const std::string& message, ErrorReportEx& report) { return Report(category, code, message, report, _aggregates); }
+        //! Account the error and prepare its report with the given aggregates
+        /*!
+            \param category - Error category name
+            \param code - Error code
+            \param message - Error message
+            \param report - Error report
+            \param aggregates - Error aggregates of the session
+            \return 'true' if the error should be reported, 'false' if it is collapsed into the next report
+        */
+        bool Report(const std::string& category, int code, const std::string& message, ErrorReportEx& report, ErrorAggregatesEx& aggregates);
+        //! Flush reports of collapsed repeats which are still waiting for their report
+        void Flush(std::vector<ErrorReportEx>& reports) { Flush(_aggregates, reports); }
+        //! Flush reports of collapsed repeats of the given aggregates
+        static void Flush(ErrorAggregatesEx& aggregates, std::vector<ErrorReportEx>& reports);
+
+        //! Prepare the error report without accounting
+        static void Describe(const std::string& category, int code, const std::string& message, ErrorReportEx& report);
+
+        //! Get the error category by its name
+        static int Category(const std::string& category) noexcept;
+        //! Get the short name of the error category (e.g. 'system')
+        static const char* CategoryName(int category) noexcept;
+        //! Intern the error category name and message
+        static uint32_t Intern(const std::string& category, int code, const std::string& message);
+        //! Get the interned error category name
+        static std::string InternedCategory(uint32_t index);
+        //! Get the interned error message
+        static std::string InternedMessage(uint32_t index);
+
+    private:
+        std::atomic<uint64_t> _errors[Categories]{};
+        std::atomic<uint64_t> _suppressed{0};
+        std::atomic<int64_t> _option_aggregation{0};
+        ErrorAggregatesEx _aggregates;
+    };
+
+    //! Error information
+    /*!
+        Structured error notification. Error category name and message are
+        converted into managed strings only when they are requested.
+    */
+    public value struct ErrorInfo
+    {
+    public:
+        //! Get the error category
+        property ErrorCategory Category { ErrorCategory get() { return _category; } }
+        //! Get the error code
+        property int Code { int get() { return _code; } }
+        //! Get the number of identical errors collapsed into this report (1 without aggregation)
+        property long long Count { long long get() { return _count; } }
+        //! Get the error category name (e.g. 'asio.system')
+        property String^ CategoryName { String^ get(); }
+        //! Get the error message
+        property String^ Message { String^ get(); }
+
+        virtual String^ ToString() override;
+
+    internal:
+        ErrorInfo(const ErrorReportEx& report) :
+            _category((ErrorCategory)report.category),
+            _code(report.code),
+            _count((long long)report.count),
+            _message(report.message)
+        {}
+
+    private:
+        ErrorCategory _category;
+        int _code;
+        long long _count;
+        uint32_t _message;
+    };
+
+}
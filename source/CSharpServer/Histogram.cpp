@@ -0,0 +1,92 @@
+#include "stdafx.h"
+
+#include "Histogram.h"
+
+namespace CSharpServer {
+
+    HistogramEx::HistogramEx() : _buckets(Buckets)
+    {
+        Reset();
+    }
+
+    size_t HistogramEx::Index(uint64_t value) noexcept
+    {
+        if (value < ((uint64_t)1 << SubBits))
+            return (size_t)value;
+
+        // Find the most significant bit
+        size_t msb = 0;
+        for (size_t shift = 32; shift > 0; shift >>= 1)
+        {
+            if ((value >> (msb + shift)) != 0)
+                msb += shift;
+        }
+
+        size_t exponent = msb - SubBits + 1;
+        return exponent * SubHalf + (size_t)(value >> exponent);
+    }
+
+    uint64_t HistogramEx::Value(size_t index) noexcept
+    {
+        if (index < ((size_t)1 << SubBits))
+            return (uint64_t)index;
+
+        // Report the middle of the bucket
+        size_t exponent = index / SubHalf - 1;
+        uint64_t mantissa = (uint64_t)(index - exponent * SubHalf);
+        return (mantissa << exponent) + (((uint64_t)1 << exponent) >> 1);
+    }
+
+    void HistogramEx::Record(uint64_t value) noexcept
+    {
+        _buckets[Index(value)].fetch_add(1, std::memory_order_relaxed);
+        _count.fetch_add(1, std::memory_order_relaxed);
+        _sum.fetch_add(value, std::memory_order_relaxed);
+
+        uint64_t min = _min.load(std::memory_order_relaxed);
+        while ((value < min) && !_min.compare_exchange_weak(min, value, std::memory_order_relaxed));
+        uint64_t max = _max.load(std::memory_order_relaxed);
+        while ((value > max) && !_max.compare_exchange_weak(max, value, std::memory_order_relaxed));
+    }
+
+    uint64_t HistogramEx::Percentile(double percentile) const noexcept
+    {
+        uint64_t count = _count.load(std::memory_order_relaxed);
+        if (count == 0)
+            return 0;
+
+        percentile = std::min(std::max(percentile, 0.0), 100.0);
+        uint64_t rank = std::max((uint64_t)((percentile / 100.0) * count + 0.5), (uint64_t)1);
+
+        uint64_t total = 0;
+        for (size_t i = 0; i < _buckets.size(); ++i)
+        {
+            total += _buckets[i].load(std::memory_order_relaxed);
+            if (total >= rank)
+                return std::min(std::max(Value(i), minimum()), maximum());
+        }
+
+        return maximum();
+    }
+
+    void HistogramEx::Reset() noexcept
+    {
+        for (auto& bucket : _buckets)
+            bucket.store(0, std::memory_order_relaxed);
+        _count = 0;
+        _sum = 0;
+        _min = std::numeric_limits<uint64_t>::max();
+        _max = 0;
+    }
+
+    Histogram::Histogram() :
+        _histogram(new std::shared_ptr<HistogramEx>(std::make_shared<HistogramEx>()))
+    {
+    }
+
+    Histogram::Histogram(const std::shared_ptr<HistogramEx>& histogram) :
+        _histogram(new std::shared_ptr<HistogramEx>(histogram))
+    {
+    }
+
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "Service.h"
+
+#include <vector>
+
+namespace CSharpServer {
+
+    //! Lock-free log-linear histogram
+    /*!
+        Values below 128 are counted exactly, larger values in buckets with 64
+        linear sub-buckets per power of two. Percentiles report the middle of the
+        bucket, so the relative error is at most 1/128 (below 0.8%).
+        Recording is wait-free and can be done from any thread.
+    */
+    class HistogramEx
+    {
+    public:
+        HistogramEx();
+        HistogramEx(const HistogramEx&) = delete;
+        HistogramEx(HistogramEx&&) = delete;
+        ~HistogramEx() = default;
+
+        HistogramEx& operator=(const HistogramEx&) = delete;
+        HistogramEx& operator=(HistogramEx&&) = delete;
+
+        uint64_t count() const noexcept { return _count; }
+        uint64_t minimum() const noexcept { return (_count > 0) ? _min.load() : 0; }
+        uint64_t maximum() const noexcept { return _max; }
+        double mean() const noexcept { uint64_t count = _count; return (count > 0) ? ((double)_sum / count) : 0.0; }
+
+        //! Record the value
+        void Record(uint64_t value) noexcept;
+        //! Get the value at the given percentile in range [0.0, 100.0]
+        uint64_t Percentile(double percentile) const noexcept;
+        //! Reset the histogram
+        void Reset() noexcept;
+
+    private:
+        static const size_t SubBits = 7;
+        static const size_t SubHalf = (size_t)1 << (SubBits - 1);
+        static const size_t Buckets = (64 - SubBits + 1) * SubHalf + SubHalf;
+
+        std::vector<std::atomic<uint64_t>> _buckets;
+        std::atomic<uint64_t> _count;
+        std::atomic<uint64_t> _sum;
+        std::atomic<uint64_t> _min;
+        std::atomic<uint64_t> _max;
+
+        static size_t Index(uint64_t value) noexcept;
+        static uint64_t Value(size_t index) noexcept;
+    };
+
+    //! Histogram
+    /*!
+        Histogram is used to collect latency distributions in nanoseconds.
+        Thread-safe.
+    */
+    public ref class Histogram
+    {
+    public:
+        //! Initialize a new empty histogram
+        Histogram();
+        ~Histogram() { this->!Histogram(); }
+
+        //! Get the number of recorded values
+        property long long Count { long long get() { return (long long)_histogram->get()->count(); } }
+        //! Get the minimal recorded value
+        property long long Min { long long get() { return (long long)_histogram->get()->minimum(); } }
+        //! Get the maximal recorded value
+        property long long Max { long long get() { return (long long)_histogram->get()->maximum(); } }
+        //! Get the mean of recorded values
+        property double Mean { double get() { return _histogram->get()->mean(); } }
+
+        //! Record the value
+        /*!
+            \param value - Value to record
+        */
+        void Record(long long value) { _histogram->get()->Record((value > 0) ? (uint64_t)value : 0); }
+        //! Get the value at the given percentile
+        /*!
+            \param percentile - Percentile in range [0.0, 100.0]
+            \return Value at the given percentile
+        */
+        long long Percentile(double percentile) { return (long long)_histogram->get()->Percentile(percentile); }
+        //! Reset the histogram
+        void Reset() { _histogram->get()->Reset(); }
+
+    protected:
+        !Histogram() { _histogram.Release(); }
+
+    internal:
+        //! Initialize the histogram with a given native histogram
+        Histogram(const std::shared_ptr<HistogramEx>& histogram);
+
+        Embedded<std::shared_ptr<HistogramEx>> _histogram;
+    };
+
+}
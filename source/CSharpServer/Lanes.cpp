@@ -0,0 +1,191 @@
+#include "stdafx.h"
+
+#include "Lanes.h"
+
+namespace CSharpServer {
+
+    //! Weighted scheduling weights from Control to Bulk lane
+    static const int64_t Weights[] = { 8, 4, 2, 1 };
+
+    void SendLanesEx::Attach(const Writer& writer, size_t window, bool weighted)
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        _writer = writer;
+        _window = (window > 0) ? window : 1;
+        _weighted = weighted;
+        _inflight = 0;
+        _current = 0;
+        _enabled.store(true, std::memory_order_release);
+    }
+
+    void SendLanesEx::Detach()
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        _enabled.store(false, std::memory_order_release);
+
+        // Drop messages which cannot be sent anymore
+        for (Lane& lane : _lanes)
+        {
+            lane.buffer.clear();
+            lane.offset = 0;
+            lane.messages.clear();
+            lane.deficit = 0;
+            lane.pending = 0;
+        }
+        _pending = 0;
+        _inflight = 0;
+    }
+
+    bool SendLanesEx::Send(int lane, const void* buffer, size_t size)
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        if (!enabled())
+            return false;
+
+        if (size == 0)
+            return true;
+
+        if (lane < 0)
+            lane = 0;
+        if (lane >= (int)Lanes)
+            lane = (int)Lanes - 1;
+
+        // Nothing waits and the window is open, so the message goes straight into the send buffer
+        if ((_pending == 0) && (_inflight < _window))
+        {
+            _inflight += size;
+            return _writer(buffer, size);
+        }
+
+        Lane& target = _lanes[lane];
+        const uint8_t* bytes = (const uint8_t*)buffer;
+        target.buffer.insert(target.buffer.end(), bytes, bytes + size);
+        target.messages.push_back(size);
+        target.pending += size;
+        _pending += size;
+
+        Pump();
+        return true;
+    }
+
+    void SendLanesEx::Sent(size_t pending)
+    {
+        if (!enabled())
+            return;
+
+        std::lock_guard<std::mutex> locker(_lock);
+
+        _inflight = pending;
+        Pump();
+    }
+
+    void SendLanesEx::Drain()
+    {
+        if (!enabled())
+            return;
+
+        std::lock_guard<std::mutex> locker(_lock);
+
+        for (Lane& lane : _lanes)
+        {
+            if (lane.messages.empty())
+                continue;
+
+            size_t size = lane.buffer.size() - lane.offset;
+            bool result = _writer(lane.buffer.data() + lane.offset, size);
+
+            lane.buffer.clear();
+            lane.offset = 0;
+            lane.messages.clear();
+            lane.deficit = 0;
+            lane.pending = 0;
+            _pending -= size;
+            _inflight += size;
+
+            if (!result)
+                return;
+        }
+    }
+
+    int SendLanesEx::Next()
+    {
+        if (!_weighted)
+        {
+            for (size_t i = 0; i < Lanes; ++i)
+                if (!_lanes[i].messages.empty())
+                    return (int)i;
+            return -1;
+        }
+
+        if (_pending == 0)
+            return -1;
+
+        // Deficit round robin: every visit adds the lane quantum until the next message fits
+        for (;;)
+        {
+            Lane& lane = _lanes[_current];
+            if (lane.messages.empty())
+                lane.deficit = 0;
+            else if (lane.deficit >= (int64_t)lane.messages.front())
+                return (int)_current;
+            else
+                lane.deficit += Weights[_current] * Quantum;
+            _current = (_current + 1) % Lanes;
+        }
+    }
+
+    void SendLanesEx::Pump()
+    {
+        while (_inflight < _window)
+        {
+            int index = Next();
+            if (index < 0)
+                return;
+
+            Lane& lane = _lanes[index];
+
+            // Take whole messages up to the send window, but at least one
+            size_t budget = _window - _inflight;
+            size_t size = 0;
+            size_t count = 0;
+            while (count < lane.messages.size())
+            {
+                size_t message = lane.messages[count];
+                if ((count > 0) && (((size + message) > budget) || (_weighted && (lane.deficit < (int64_t)(size + message)))))
+                    break;
+                size += message;
+                ++count;
+            }
+
+            bool result = _writer(lane.buffer.data() + lane.offset, size);
+
+            if (_weighted)
+                lane.deficit -= (int64_t)size;
+            lane.offset += size;
+            lane.messages.erase(lane.messages.begin(), lane.messages.begin() + count);
+            lane.pending -= size;
+            _pending -= size;
+            _inflight += size;
+
+            // Reclaim the sent part of the lane buffer
+            if (lane.messages.empty())
+            {
+                lane.buffer.clear();
+                lane.offset = 0;
+                lane.deficit = 0;
+            }
+            else if (lane.offset > (lane.buffer.size() / 2))
+            {
+                lane.buffer.erase(lane.buffer.begin(), lane.buffer.begin() + lane.offset);
+                lane.offset = 0;
+            }
+
+            if (!result)
+                return;
+        }
+    }
+
+}
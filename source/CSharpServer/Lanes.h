@@ -0,0 +1,125 @@
+#pragma once
+
+#include "Service.h"
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace CSharpServer {
+
+    //! Send priority
+    public enum class SendPriority
+    {
+        //! Control messages, e.g. heartbeats or cancels
+        Control,
+        //! High priority messages
+        High,
+        //! Normal priority messages (SendAsync() without priority)
+        Normal,
+        //! Bulk data
+        Bulk
+    };
+
+    //! Send scheduling of priority lanes
+    public enum class SendScheduling
+    {
+        //! Single FIFO send queue, priorities are ignored
+        None,
+        //! Higher priority lanes are always sent first
+        Strict,
+        //! Backlogged lanes share the send bandwidth 8:4:2:1 from Control to Bulk
+        Weighted
+    };
+
+    //! Send lanes
+    /*!
+        Priority lanes in front of the session send buffer. Messages wait in
+        their lanes and are moved into the send buffer as whole messages only
+        while the send buffer holds less than the send window, so a control
+        message waits at most for the send window plus the largest message
+        already moved into the send buffer instead of the whole send backlog.
+        Messages are written at once without waiting in lanes while all lanes
+        are empty and the send window is open.
+
+        Thread-safe.
+    */
+    class SendLanesEx
+    {
+    public:
+        static const size_t Lanes = 4;
+
+        //! Writer of messages into the send buffer
+        typedef std::function<bool(const void*, size_t)> Writer;
+
+        SendLanesEx() = default;
+        SendLanesEx(const SendLanesEx&) = delete;
+        SendLanesEx(SendLanesEx&&) = delete;
+        ~SendLanesEx() = default;
+
+        SendLanesEx& operator=(const SendLanesEx&) = delete;
+        SendLanesEx& operator=(SendLanesEx&&) = delete;
+
+        bool enabled() const noexcept { return _enabled.load(std::memory_order_acquire); }
+        //! Get the number of bytes waiting in all lanes
+        size_t pending() const noexcept { return _pending.load(std::memory_order_relaxed); }
+        //! Get the number of bytes waiting in the given lane
+        size_t pending(int lane) const noexcept { return ((lane >= 0) && (lane < (int)Lanes)) ? _lanes[lane].pending.load(std::memory_order_relaxed) : 0; }
+
+        //! Attach lanes to the connected session
+        /*!
+            \param writer - Writer of messages into the send buffer
+            \param window - Send window in bytes
+            \param weighted - Weighted scheduling (otherwise strict)
+        */
+        void Attach(const Writer& writer, size_t window, bool weighted);
+        //! Detach lanes from the disconnected session and drop waiting messages
+        void Detach();
+
+        //! Send the message through the given lane
+        /*!
+            \param lane - Lane (SendPriority)
+            \param buffer - Message buffer
+            \param size - Message size
+            \return 'true' if the message was queued or written, 'false' if lanes are detached or the write failed
+        */
+        bool Send(int lane, const void* buffer, size_t size);
+        //! Update the send buffer size after the send notification and refill it
+        void Sent(size_t pending);
+        //! Move all waiting messages into the send buffer regardless of the send window
+        /*!
+            Used before a send which bypasses lanes (e.g. the file send), so messages
+            sent earlier are not written after it. Lanes are drained from Control to Bulk.
+        */
+        void Drain();
+
+    private:
+        //! Deficit quantum of the lane with weight 1
+        static const int64_t Quantum = 4096;
+
+        struct Lane
+        {
+            std::vector<uint8_t> buffer;
+            size_t offset{0};
+            std::deque<size_t> messages;
+            int64_t deficit{0};
+            std::atomic<size_t> pending{0};
+        };
+
+        std::mutex _lock;
+        std::atomic<bool> _enabled{false};
+        Writer _writer;
+        size_t _window{0};
+        bool _weighted{false};
+        size_t _inflight{0};
+        size_t _current{0};
+        Lane _lanes[Lanes];
+        std::atomic<size_t> _pending{0};
+
+        //! Select the lane to send from (-1 if all lanes are empty)
+        int Next();
+        //! Move waiting messages into the send buffer up to the send window
+        void Pump();
+    };
+
+}
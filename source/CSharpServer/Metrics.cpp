@@ -0,0 +1,386 @@
+#include "stdafx.h"
+
+#include "Metrics.h"
+
+#include <threads/thread.h>
+
+#include <sstream>
+
+namespace CSharpServer {
+
+    //! Metrics endpoint session
+    /*!
+        Reads the request head and answers it with the metrics exposition,
+        then closes the connection once the response is sent.
+    */
+    class MetricsSessionEx : public CppServer::Asio::TCPSession
+    {
+    public:
+        MetricsSessionEx(const std::shared_ptr<CppServer::Asio::TCPServer>& server, const std::weak_ptr<MetricsEx>& metrics) : TCPSession(server), _metrics(metrics) {}
+
+        void onReceived(const void* buffer, size_t size) override;
+        void onEmpty() override;
+
+    private:
+        static const size_t MaxRequestSize = 8192;
+
+        std::weak_ptr<MetricsEx> _metrics;
+        std::string _request;
+        bool _answered{false};
+    };
+
+    //! Metrics endpoint server
+    class MetricsServerEx : public CppServer::Asio::TCPServer
+    {
+    public:
+        MetricsServerEx(const std::shared_ptr<CppServer::Asio::Service>& service, int port, const std::weak_ptr<MetricsEx>& metrics) : TCPServer(service, "127.0.0.1", port), _metrics(metrics) {}
+
+    protected:
+        std::shared_ptr<CppServer::Asio::TCPSession> CreateSession(std::shared_ptr<TCPServer> server) override { return std::make_shared<MetricsSessionEx>(server, _metrics); }
+
+    private:
+        std::weak_ptr<MetricsEx> _metrics;
+    };
+
+    void MetricsSessionEx::onReceived(const void* buffer, size_t size)
+    {
+        if (_answered)
+            return;
+
+        _request.append((const char*)buffer, size);
+        if (_request.find("\r\n\r\n") == std::string::npos)
+        {
+            // Drop the client which never completes the request head
+            if (_request.size() > MaxRequestSize)
+                Disconnect();
+            return;
+        }
+
+        std::string status = "200 OK";
+        std::string body;
+        auto metrics = _metrics.lock();
+        if (_request.compare(0, 4, "GET ") != 0)
+            status = "405 Method Not Allowed";
+        else if (metrics)
+            body = metrics->Exposition();
+        else
+            status = "503 Service Unavailable";
+
+        std::ostringstream response;
+        response << "HTTP/1.1 " << status << "\r\n";
+        response << "Content-Type: text/plain; version=0.0.4\r\n";
+        response << "Content-Length: " << body.size() << "\r\n";
+        response << "Connection: close\r\n";
+        response << "\r\n";
+        response << body;
+
+        _answered = true;
+        _request.clear();
+        if (!SendAsync(response.str()))
+            Disconnect();
+    }
+
+    void MetricsSessionEx::onEmpty()
+    {
+        if (_answered)
+            Disconnect();
+    }
+
+    static const char* CallbackNames[] = { "connected", "disconnected", "handshaked", "received", "sent", "empty", "error", "timer", "expired" };
+
+    void CallbackProfilerEx::SetupProfiling(bool enable)
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        // Register profiling metrics only when profiling is enabled for the first time
+        if (enable && (_durations[0] == nullptr))
+        {
+            for (size_t i = 0; i < Types; ++i)
+            {
+                std::string label = MetricsEx::Label("callback", CallbackNames[i]);
+                _durations[i] = &_metrics.Histogram("callback_duration_nanoseconds", label);
+                _slow[i] = &_metrics.Counter("slow_callbacks_total", label);
+            }
+        }
+
+        _enabled.store(enable, std::memory_order_release);
+    }
+
+    void CallbackProfilerEx::Record(int type, int64_t duration, const CppCommon::UUID* id)
+    {
+        if (!enabled() || (type < 0) || (type >= (int)Types))
+            return;
+
+        if (duration < 0)
+            duration = 0;
+
+        _durations[type]->Record((uint64_t)duration);
+        if (duration < _option_slow_threshold)
+            return;
+
+        ++_slow_callbacks;
+        _slow[type]->Add();
+
+        // Report the slow callback from the stalled thread
+        Service^ service = root;
+        if (service != nullptr)
+        {
+            String^ name = (id != nullptr) ? marshal_as<String^>(id->string()) : String::Empty;
+            service->InternalOnSlowCallback((CallbackType)type, name, (long long)CppCommon::Thread::CurrentThreadId(), TimeSpan(duration / 100));
+        }
+    }
+
+    size_t CounterEx::Shard() noexcept
+    {
+        return std::hash<std::thread::id>()(std::this_thread::get_id()) % Shards;
+    }
+
+    uint64_t CounterEx::value() const noexcept
+    {
+        uint64_t result = 0;
+        for (const Cell& shard : _shards)
+            result += shard.value.load(std::memory_order_relaxed);
+        return result;
+    }
+
+    int64_t GaugeEx::value() const noexcept
+    {
+        int64_t result = 0;
+        for (const Cell& shard : _shards)
+            result += shard.value.load(std::memory_order_relaxed);
+        return result;
+    }
+
+    MetricsEx::~MetricsEx()
+    {
+        StopEndpoint();
+    }
+
+    CounterEx& MetricsEx::Counter(const std::string& name, const std::string& labels)
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        auto& counter = _counters[Key(name, labels)];
+        if (!counter)
+            counter.reset(new CounterEx());
+        return *counter;
+    }
+
+    GaugeEx& MetricsEx::Gauge(const std::string& name, const std::string& labels)
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        auto& gauge = _gauges[Key(name, labels)];
+        if (!gauge)
+            gauge.reset(new GaugeEx());
+        return *gauge;
+    }
+
+    HistogramEx& MetricsEx::Histogram(const std::string& name, const std::string& labels)
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        auto& histogram = _histograms[Key(name, labels)];
+        if (!histogram)
+            histogram.reset(new HistogramEx());
+        return *histogram;
+    }
+
+    static const double Quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+    void MetricsEx::Collect(std::vector<std::pair<std::string, double>>& samples)
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        for (auto& counter : _counters)
+            samples.emplace_back(Sample(counter.first), (double)counter.second->value());
+        for (auto& gauge : _gauges)
+            samples.emplace_back(Sample(gauge.first), (double)gauge.second->value());
+        for (auto& histogram : _histograms)
+        {
+            for (double quantile : Quantiles)
+            {
+                std::ostringstream label;
+                label << quantile;
+                samples.emplace_back(Sample(histogram.first, Label("quantile", label.str())), (double)histogram.second->Percentile(quantile * 100.0));
+            }
+            samples.emplace_back(Sample(histogram.first, "", "_sum"), histogram.second->mean() * histogram.second->count());
+            samples.emplace_back(Sample(histogram.first, "", "_count"), (double)histogram.second->count());
+        }
+    }
+
+    std::string MetricsEx::Exposition()
+    {
+        std::ostringstream stream;
+
+        std::lock_guard<std::mutex> locker(_lock);
+
+        // Samples of the same metric are adjacent in maps ordered by name
+        std::string family;
+        for (auto& counter : _counters)
+        {
+            if (counter.first.first != family)
+            {
+                family = counter.first.first;
+                stream << "# TYPE " << family << " counter\n";
+            }
+            stream << Sample(counter.first) << ' ' << counter.second->value() << '\n';
+        }
+
+        family.clear();
+        for (auto& gauge : _gauges)
+        {
+            if (gauge.first.first != family)
+            {
+                family = gauge.first.first;
+                stream << "# TYPE " << family << " gauge\n";
+            }
+            stream << Sample(gauge.first) << ' ' << gauge.second->value() << '\n';
+        }
+
+        family.clear();
+        for (auto& histogram : _histograms)
+        {
+            if (histogram.first.first != family)
+            {
+                family = histogram.first.first;
+                stream << "# TYPE " << family << " summary\n";
+            }
+            for (double quantile : Quantiles)
+            {
+                std::ostringstream label;
+                label << quantile;
+                stream << Sample(histogram.first, Label("quantile", label.str())) << ' ' << histogram.second->Percentile(quantile * 100.0) << '\n';
+            }
+            uint64_t count = histogram.second->count();
+            stream << Sample(histogram.first, "", "_sum") << ' ' << (uint64_t)(histogram.second->mean() * count) << '\n';
+            stream << Sample(histogram.first, "", "_count") << ' ' << count << '\n';
+        }
+
+        return stream.str();
+    }
+
+    bool MetricsEx::IsEndpointStarted()
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+        return (_endpoint != nullptr);
+    }
+
+    bool MetricsEx::StartEndpoint(const std::shared_ptr<CppServer::Asio::Service>& service, int port)
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        if (_endpoint)
+            return false;
+
+        auto endpoint = std::make_shared<MetricsServerEx>(service, port, std::weak_ptr<MetricsEx>(shared_from_this()));
+        if (!endpoint->Start())
+            return false;
+
+        _endpoint = endpoint;
+        return true;
+    }
+
+    bool MetricsEx::StopEndpoint()
+    {
+        std::shared_ptr<CppServer::Asio::TCPServer> endpoint;
+        {
+            std::lock_guard<std::mutex> locker(_lock);
+            std::swap(endpoint, _endpoint);
+        }
+
+        if (!endpoint)
+            return false;
+
+        return endpoint->Stop();
+    }
+
+    int64_t MetricsEx::Now() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    std::string MetricsEx::Label(const std::string& name, const std::string& value)
+    {
+        std::string result = name + "=\"";
+        for (char ch : value)
+        {
+            if ((ch == '\\') || (ch == '"'))
+                result += '\\';
+            if (ch == '\n')
+                result += "\\n";
+            else
+                result += ch;
+        }
+        result += '"';
+        return result;
+    }
+
+    std::string MetricsEx::Sample(const Key& key, const std::string& extra, const std::string& suffix)
+    {
+        std::string result = key.first + suffix;
+        if (key.second.empty() && extra.empty())
+            return result;
+
+        result += '{';
+        result += key.second;
+        if (!key.second.empty() && !extra.empty())
+            result += ',';
+        result += extra;
+        result += '}';
+        return result;
+    }
+
+    void ConnectionMetricsEx::Setup(const std::shared_ptr<MetricsEx>& metrics, const std::string& prefix)
+    {
+        _metrics = metrics;
+        _connected = &metrics->Counter(prefix + "_connected_total");
+        _disconnected = &metrics->Counter(prefix + "_disconnected_total");
+        _rejected = &metrics->Counter(prefix + "_rejected_total");
+        _received = &metrics->Counter(prefix + "_received_total");
+        _received_bytes = &metrics->Counter(prefix + "_received_bytes_total");
+        _connections = &metrics->Gauge(prefix + "_connections");
+        _receive_callback = &metrics->Histogram(prefix + "_receive_callback_nanoseconds");
+        _send_queue = &metrics->Histogram(prefix + "_send_queue_bytes");
+        for (size_t i = 0; i < ErrorsEx::Categories; ++i)
+            _errors[i] = &metrics->Counter(prefix + "_errors_total", MetricsEx::Label("category", ErrorsEx::CategoryName((int)i)));
+        _profiler = &metrics->profiler();
+        _trace = metrics->trace().get();
+    }
+
+    void ConnectionMetricsEx::Received(size_t size, int64_t duration) noexcept
+    {
+        if (_received == nullptr)
+            return;
+
+        _received->Add();
+        _received_bytes->Add(size);
+        _receive_callback->Record((duration > 0) ? (uint64_t)duration : 0);
+    }
+
+    Metrics::Metrics(CSharpServer::Service^ service, const std::shared_ptr<MetricsEx>& metrics) :
+        _service(service),
+        _metrics(new std::shared_ptr<MetricsEx>(metrics))
+    {
+    }
+
+    System::Collections::Generic::Dictionary<String^, double>^ Metrics::Snapshot()
+    {
+        std::vector<std::pair<std::string, double>> samples;
+        _metrics->get()->Collect(samples);
+
+        auto result = gcnew System::Collections::Generic::Dictionary<String^, double>((int)samples.size());
+        for (auto& sample : samples)
+            result[marshal_as<String^>(sample.first)] = sample.second;
+        return result;
+    }
+
+    bool Metrics::StartEndpoint(int port)
+    {
+        if ((port <= 0) || (port > 65535))
+            throw gcnew ArgumentException("Invalid metrics endpoint port!", "port");
+
+        return _metrics->get()->StartEndpoint(_service->_service.Value, port);
+    }
+
+}
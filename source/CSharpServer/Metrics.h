@@ -0,0 +1,503 @@
+#pragma once
+
+#include "Histogram.h"
+#include "Trace.h"
+
+#include <server/asio/tcp_server.h>
+#include <system/uuid.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace CSharpServer {
+
+    ref class Service;
+
+    //! Sharded counter
+    /*!
+        Counter is split into cache line padded shards selected by the calling
+        thread, so service threads increment it without contention. The value
+        is the sum of all shards.
+    */
+    class CounterEx
+    {
+    public:
+        CounterEx() = default;
+        CounterEx(const CounterEx&) = delete;
+        CounterEx(CounterEx&&) = delete;
+        ~CounterEx() = default;
+
+        CounterEx& operator=(const CounterEx&) = delete;
+        CounterEx& operator=(CounterEx&&) = delete;
+
+        //! Get the counter value
+        uint64_t value() const noexcept;
+
+        //! Increment the counter
+        void Add(uint64_t value = 1) noexcept { _shards[Shard()].value.fetch_add(value, std::memory_order_relaxed); }
+
+        //! Get the shard index of the calling thread
+        static size_t Shard() noexcept;
+
+        static const size_t Shards = 16;
+
+    private:
+        struct Cell
+        {
+            std::atomic<uint64_t> value{0};
+            uint8_t padding[64 - sizeof(std::atomic<uint64_t>)];
+        };
+
+        Cell _shards[Shards];
+    };
+
+    //! Sharded gauge
+    class GaugeEx
+    {
+    public:
+        GaugeEx() = default;
+        GaugeEx(const GaugeEx&) = delete;
+        GaugeEx(GaugeEx&&) = delete;
+        ~GaugeEx() = default;
+
+        GaugeEx& operator=(const GaugeEx&) = delete;
+        GaugeEx& operator=(GaugeEx&&) = delete;
+
+        //! Get the gauge value
+        int64_t value() const noexcept;
+
+        //! Increase the gauge
+        void Add(int64_t value = 1) noexcept { _shards[CounterEx::Shard()].value.fetch_add(value, std::memory_order_relaxed); }
+        //! Decrease the gauge
+        void Sub(int64_t value = 1) noexcept { _shards[CounterEx::Shard()].value.fetch_sub(value, std::memory_order_relaxed); }
+
+    private:
+        struct Cell
+        {
+            std::atomic<int64_t> value{0};
+            uint8_t padding[64 - sizeof(std::atomic<int64_t>)];
+        };
+
+        Cell _shards[CounterEx::Shards];
+    };
+
+    class MetricsEx;
+
+    //! Callback profiler
+    /*!
+        Measures durations of user callbacks by their type (CallbackType) and
+        reports callbacks slower than the threshold, because a blocked handler
+        stalls all other handlers of the same service thread. Disabled profiler
+        costs one atomic load per callback.
+
+        Thread-safe.
+    */
+    class CallbackProfilerEx
+    {
+    public:
+        explicit CallbackProfilerEx(MetricsEx& metrics) : _metrics(metrics) {}
+        CallbackProfilerEx(const CallbackProfilerEx&) = delete;
+        CallbackProfilerEx(CallbackProfilerEx&&) = delete;
+        ~CallbackProfilerEx() = default;
+
+        CallbackProfilerEx& operator=(const CallbackProfilerEx&) = delete;
+        CallbackProfilerEx& operator=(CallbackProfilerEx&&) = delete;
+
+        gcroot<Service^> root;
+
+        bool enabled() const noexcept { return _enabled.load(std::memory_order_acquire); }
+        int64_t option_slow_threshold() const noexcept { return _option_slow_threshold; }
+        uint64_t slow_callbacks() const noexcept { return _slow_callbacks; }
+
+        //! Enable or disable profiling
+        void SetupProfiling(bool enable);
+        //! Setup the slow callback threshold in nanoseconds
+        void SetupSlowThreshold(int64_t threshold) noexcept { _option_slow_threshold = threshold; }
+
+        //! Start timing of the callback
+        /*!
+            \return Start time or zero if profiling is disabled
+        */
+        int64_t Begin() const noexcept;
+        //! Finish timing of the callback started with Begin()
+        /*!
+            \param type - Callback type (CallbackType)
+            \param start - Start time returned by Begin()
+            \param id - Session, client or server Id (optional)
+        */
+        void End(int type, int64_t start, const CppCommon::UUID* id = nullptr);
+        //! Record the measured callback duration if profiling is enabled
+        /*!
+            \param type - Callback type (CallbackType)
+            \param duration - Callback duration in nanoseconds
+            \param id - Session, client or server Id (optional)
+        */
+        void Record(int type, int64_t duration, const CppCommon::UUID* id = nullptr);
+
+    private:
+        static const size_t Types = 9;
+
+        MetricsEx& _metrics;
+        std::mutex _lock;
+        std::atomic<bool> _enabled{false};
+        std::atomic<int64_t> _option_slow_threshold{100000000};
+        std::atomic<uint64_t> _slow_callbacks{0};
+        HistogramEx* _durations[Types]{};
+        CounterEx* _slow[Types]{};
+    };
+
+    //! Metrics registry
+    /*!
+        Registry of named counters, gauges and histograms shared by the service
+        and all its servers and clients. Metrics are created on the first use
+        and never removed, so references to them stay valid while the registry
+        is alive. Histograms are reported as summaries with 0.5, 0.9, 0.99 and
+        0.999 quantiles.
+
+        Thread-safe.
+    */
+    class MetricsEx : public std::enable_shared_from_this<MetricsEx>
+    {
+    public:
+        MetricsEx() : _profiler(*this) {}
+        MetricsEx(const MetricsEx&) = delete;
+        MetricsEx(MetricsEx&&) = delete;
+        ~MetricsEx();
+
+        MetricsEx& operator=(const MetricsEx&) = delete;
+        MetricsEx& operator=(MetricsEx&&) = delete;
+
+        CallbackProfilerEx& profiler() noexcept { return _profiler; }
+        const std::shared_ptr<TraceEx>& trace() const noexcept { return _trace; }
+
+        //! Get or create the counter with a given name and labels (e.g. 'category="asio.system"')
+        CounterEx& Counter(const std::string& name, const std::string& labels = "");
+        //! Get or create the gauge with a given name and labels
+        GaugeEx& Gauge(const std::string& name, const std::string& labels = "");
+        //! Get or create the histogram with a given name and labels
+        HistogramEx& Histogram(const std::string& name, const std::string& labels = "");
+
+        //! Collect samples of all metrics
+        /*!
+            \param samples - Samples with 'name{labels}' keys
+        */
+        void Collect(std::vector<std::pair<std::string, double>>& samples);
+        //! Get all metrics in the Prometheus text exposition format
+        std::string Exposition();
+
+        //! Is the metrics endpoint started?
+        bool IsEndpointStarted();
+        //! Start the metrics endpoint on the loopback interface
+        /*!
+            \param service - Service to serve scrape requests
+            \param port - Port number
+            \return 'true' if the endpoint was successfully started, 'false' if it is already started or failed to start
+        */
+        bool StartEndpoint(const std::shared_ptr<CppServer::Asio::Service>& service, int port);
+        //! Stop the metrics endpoint
+        bool StopEndpoint();
+
+        //! Get the steady clock time in nanoseconds to measure durations
+        static int64_t Now() noexcept;
+        //! Make the label with a given name and escaped value (e.g. 'category="asio.system"')
+        static std::string Label(const std::string& name, const std::string& value);
+
+    private:
+        typedef std::pair<std::string, std::string> Key;
+
+        std::mutex _lock;
+        std::map<Key, std::unique_ptr<CounterEx>> _counters;
+        std::map<Key, std::unique_ptr<GaugeEx>> _gauges;
+        std::map<Key, std::unique_ptr<HistogramEx>> _histograms;
+        std::shared_ptr<CppServer::Asio::TCPServer> _endpoint;
+        CallbackProfilerEx _profiler;
+        std::shared_ptr<TraceEx> _trace{std::make_shared<TraceEx>()};
+
+        static std::string Sample(const Key& key, const std::string& extra = "", const std::string& suffix = "");
+    };
+
+    inline int64_t CallbackProfilerEx::Begin() const noexcept
+    {
+        return enabled() ? MetricsEx::Now() : 0;
+    }
+
+    inline void CallbackProfilerEx::End(int type, int64_t start, const CppCommon::UUID* id)
+    {
+        if (start != 0)
+            Record(type, MetricsEx::Now() - start, id);
+    }
+
+    //! Connection metrics
+    /*!
+        Standard metrics of one server or client kind registered with the given
+        prefix (e.g. 'tcp_server'): connections, disconnections, rejections,
+        received messages, errors by category, receive callback duration and
+        send queue depth. Metrics are shared by all instances of the same kind.
+    */
+    class ConnectionMetricsEx
+    {
+    public:
+        ConnectionMetricsEx() = default;
+        ConnectionMetricsEx(const ConnectionMetricsEx&) = delete;
+        ConnectionMetricsEx(ConnectionMetricsEx&&) = delete;
+        ~ConnectionMetricsEx() = default;
+
+        ConnectionMetricsEx& operator=(const ConnectionMetricsEx&) = delete;
+        ConnectionMetricsEx& operator=(ConnectionMetricsEx&&) = delete;
+
+        //! Register metrics with a given prefix in the given registry
+        void Setup(const std::shared_ptr<MetricsEx>& metrics, const std::string& prefix);
+
+        //! Count the connection
+        void Connected() noexcept { if (_connected != nullptr) { _connected->Add(); _connections->Add(); } }
+        //! Count the disconnection
+        void Disconnected() noexcept { if (_disconnected != nullptr) { _disconnected->Add(); _connections->Sub(); } }
+        //! Count the connection rejected by admission policies
+        void Rejected() noexcept { if (_rejected != nullptr) _rejected->Add(); }
+        //! Count the received message and its receive callback duration
+        /*!
+            \param size - Received size
+            \param duration - Receive callback duration in nanoseconds
+        */
+        void Received(size_t size, int64_t duration) noexcept;
+        //! Record the send queue depth after the send notification
+        void Sent(size_t pending) noexcept { if (_send_queue != nullptr) _send_queue->Record(pending); }
+        //! Count the error of the given category
+        void Error(int category) noexcept { if ((_errors[0] != nullptr) && (category >= 0) && (category < (int)ErrorsEx::Categories)) _errors[category]->Add(); }
+
+        //! Start timing of the user callback (zero if profiling is disabled)
+        int64_t BeginCallback() const noexcept { return (_profiler != nullptr) ? _profiler->Begin() : 0; }
+        //! Finish timing of the user callback started with BeginCallback()
+        void EndCallback(int type, int64_t start, const CppCommon::UUID& id) { if (start != 0) _profiler->End(type, start, &id); }
+        //! Record the measured duration of the user callback
+        void Callback(int type, int64_t duration, const CppCommon::UUID& id) { if ((_profiler != nullptr) && _profiler->enabled()) _profiler->Record(type, duration, &id); }
+
+        //! Record the trace event
+        void Event(TraceEx::Type type, const CppCommon::UUID& id, uint64_t value = 0) noexcept { if (_trace != nullptr) _trace->Record(type, id, value); }
+
+    private:
+        std::shared_ptr<MetricsEx> _metrics;
+        CounterEx* _connected{nullptr};
+        CounterEx* _disconnected{nullptr};
+        CounterEx* _rejected{nullptr};
+        CounterEx* _received{nullptr};
+        CounterEx* _received_bytes{nullptr};
+        GaugeEx* _connections{nullptr};
+        HistogramEx* _receive_callback{nullptr};
+        HistogramEx* _send_queue{nullptr};
+        CounterEx* _errors[ErrorsEx::Categories]{};
+        CallbackProfilerEx* _profiler{nullptr};
+        TraceEx* _trace{nullptr};
+    };
+
+    //! Metric counter
+    /*!
+        Handle of the user counter returned by Metrics.Counter(). Updates go
+        straight to the counter without the name lookup in the registry.
+
+        Thread-safe.
+    */
+    public ref class MetricCounter
+    {
+    public:
+        ~MetricCounter() { this->!MetricCounter(); }
+
+        //! Get the counter value
+        property long long Value { long long get() { return (long long)_counter->value(); } }
+
+        //! Increment the counter
+        /*!
+            \param value - Increment value
+        */
+        void Increment(long long value) { _counter->Add((value > 0) ? (uint64_t)value : 0); }
+
+    protected:
+        !MetricCounter() { _metrics.Release(); }
+
+    internal:
+        MetricCounter(const std::shared_ptr<MetricsEx>& metrics, CounterEx* counter) : _metrics(new std::shared_ptr<MetricsEx>(metrics)), _counter(counter) {}
+
+        Embedded<std::shared_ptr<MetricsEx>> _metrics;
+        CounterEx* _counter;
+    };
+
+    //! Metric gauge
+    /*!
+        Handle of the user gauge returned by Metrics.Gauge(). Updates go
+        straight to the gauge without the name lookup in the registry.
+
+        Thread-safe.
+    */
+    public ref class MetricGauge
+    {
+    public:
+        ~MetricGauge() { this->!MetricGauge(); }
+
+        //! Get the gauge value
+        property long long Value { long long get() { return (long long)_gauge->value(); } }
+
+        //! Change the gauge
+        /*!
+            \param value - Gauge change (negative to decrease)
+        */
+        void Change(long long value) { _gauge->Add(value); }
+
+    protected:
+        !MetricGauge() { _metrics.Release(); }
+
+    internal:
+        MetricGauge(const std::shared_ptr<MetricsEx>& metrics, GaugeEx* gauge) : _metrics(new std::shared_ptr<MetricsEx>(metrics)), _gauge(gauge) {}
+
+        Embedded<std::shared_ptr<MetricsEx>> _metrics;
+        GaugeEx* _gauge;
+    };
+
+    //! Metric histogram
+    /*!
+        Handle of the user histogram returned by Metrics.Histogram(). Values are
+        recorded straight into the histogram without the name lookup in the registry.
+
+        Thread-safe.
+    */
+    public ref class MetricHistogram
+    {
+    public:
+        ~MetricHistogram() { this->!MetricHistogram(); }
+
+        //! Record the value into the histogram
+        /*!
+            \param value - Value to record
+        */
+        void Record(long long value) { _histogram->Record((value > 0) ? (uint64_t)value : 0); }
+
+    protected:
+        !MetricHistogram() { _metrics.Release(); }
+
+    internal:
+        MetricHistogram(const std::shared_ptr<MetricsEx>& metrics, HistogramEx* histogram) : _metrics(new std::shared_ptr<MetricsEx>(metrics)), _histogram(histogram) {}
+
+        Embedded<std::shared_ptr<MetricsEx>> _metrics;
+        HistogramEx* _histogram;
+    };
+
+    //! Metrics
+    /*!
+        Metrics registry of the service. Servers and clients created with the
+        service report their standard metrics into it, e.g. 'tcp_server_connected_total',
+        'tcp_server_errors_total{category="system"}' or 'tcp_server_receive_callback_nanoseconds'.
+        Optional HTTP endpoint serves metrics in the Prometheus text format on
+        the loopback interface.
+
+        Thread-safe.
+    */
+    public ref class Metrics
+    {
+    public:
+        ~Metrics() { this->!Metrics(); }
+
+        //! Is the metrics endpoint started?
+        property bool IsEndpointStarted { bool get() { return _metrics->get()->IsEndpointStarted(); } }
+
+        //! Get the handle of the user counter
+        /*!
+            Handle is cheaper than Increment() with the name for frequent updates.
+
+            \param name - Counter name
+            \return Counter handle
+        */
+        MetricCounter^ Counter(String^ name) { return gcnew MetricCounter(_metrics.Value, &_metrics->get()->Counter(marshal_as<std::string>(name))); }
+        //! Get the handle of the user gauge
+        /*!
+            \param name - Gauge name
+            \return Gauge handle
+        */
+        MetricGauge^ Gauge(String^ name) { return gcnew MetricGauge(_metrics.Value, &_metrics->get()->Gauge(marshal_as<std::string>(name))); }
+        //! Get the handle of the user histogram
+        /*!
+            \param name - Histogram name
+            \return Histogram handle
+        */
+        MetricHistogram^ Histogram(String^ name) { return gcnew MetricHistogram(_metrics.Value, &_metrics->get()->Histogram(marshal_as<std::string>(name))); }
+
+        //! Increment the user counter
+        /*!
+            Counter is looked up by name on each call, use Counter() for frequent updates.
+
+            \param name - Counter name
+            \param value - Increment value
+        */
+        void Increment(String^ name, long long value) { _metrics->get()->Counter(marshal_as<std::string>(name)).Add((value > 0) ? (uint64_t)value : 0); }
+        //! Change the user gauge
+        /*!
+            Gauge is looked up by name on each call, use Gauge() for frequent updates.
+
+            \param name - Gauge name
+            \param value - Gauge change (negative to decrease)
+        */
+        void Change(String^ name, long long value) { _metrics->get()->Gauge(marshal_as<std::string>(name)).Add(value); }
+        //! Record the value into the user histogram
+        /*!
+            Histogram is looked up by name on each call, use Histogram() for frequent updates.
+
+            \param name - Histogram name
+            \param value - Value to record
+        */
+        void Record(String^ name, long long value) { _metrics->get()->Histogram(marshal_as<std::string>(name)).Record((value > 0) ? (uint64_t)value : 0); }
+
+        //! Is the callback profiling enabled?
+        property bool OptionProfiling { bool get() { return _metrics->get()->profiler().enabled(); } }
+        //! Get the slow callback threshold
+        property TimeSpan OptionSlowThreshold { TimeSpan get() { return TimeSpan(_metrics->get()->profiler().option_slow_threshold() / 100); } }
+        //! Get the number of callbacks slower than the threshold
+        property long long SlowCallbacks { long long get() { return (long long)_metrics->get()->profiler().slow_callbacks(); } }
+
+        //! Setup the callback profiling
+        /*!
+            Profiling records 'callback_duration_nanoseconds' summaries by callback type
+            and calls Service.OnSlowCallback() for callbacks slower than the threshold.
+
+            \param enable - Enable profiling (default is false)
+        */
+        void SetupProfiling(bool enable) { _metrics->get()->profiler().SetupProfiling(enable); }
+        //! Setup the slow callback threshold
+        /*!
+            \param threshold - Slow callback threshold (default is 100 milliseconds)
+        */
+        void SetupSlowThreshold(TimeSpan threshold) { _metrics->get()->profiler().SetupSlowThreshold(threshold.Ticks * 100); }
+
+        //! Take the snapshot of all metrics
+        /*!
+            \return Metric values with 'name{labels}' keys
+        */
+        System::Collections::Generic::Dictionary<String^, double>^ Snapshot();
+        //! Get all metrics in the Prometheus text exposition format
+        String^ Exposition() { return marshal_as<String^>(_metrics->get()->Exposition()); }
+
+        //! Start the metrics HTTP endpoint on the loopback interface
+        /*!
+            Endpoint answers any GET request with metrics in the Prometheus text
+            format and is served by the service threads. Endpoint keeps the service
+            alive until it is stopped with StopEndpoint() or with the service.
+
+            \param port - Port number
+            \return 'true' if the endpoint was successfully started, 'false' if it is already started or failed to start
+        */
+        bool StartEndpoint(int port);
+        //! Stop the metrics HTTP endpoint
+        /*!
+            \return 'true' if the endpoint was successfully stopped, 'false' if it is not started
+        */
+        bool StopEndpoint() { return _metrics->get()->StopEndpoint(); }
+
+    protected:
+        !Metrics() { _metrics.Release(); }
+
+    internal:
+        Metrics(Service^ service, const std::shared_ptr<MetricsEx>& metrics);
+
+        Service^ _service;
+        Embedded<std::shared_ptr<MetricsEx>> _metrics;
+    };
+
+}
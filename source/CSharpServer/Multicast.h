@@ -0,0 +1,45 @@
+#pragma once
+
+namespace CSharpServer {
+
+    //! Sequenced multicast datagram header
+    /*!
+        Sequenced multicast datagrams are prefixed with this header. The same layout
+        is used by subscribers to request retransmission of missing sequences (NACK)
+        and by the publisher to answer them with a unicast retransmit or a gone notice
+        when the requested sequences already left the retransmission ring.
+
+        Retransmits are served only to verified subscribers. The publisher answers a NACK
+        without the valid cookie with a cookie datagram (which is smaller than the NACK),
+        so a NACK with a spoofed source endpoint cannot reflect retransmits to a victim.
+    */
+    #pragma pack(push, 1)
+    struct MulticastHeader
+    {
+        //! Multicast datagram type
+        enum : uint32_t
+        {
+            Data = 0x444D5343,          //!< "CSMD" - multicasted datagram with payload
+            Retransmit = 0x524D5343,    //!< "CSMR" - retransmitted datagram with payload (unicast)
+            Nack = 0x4E4D5343,          //!< "CSMN" - retransmission request for [sequence, sequence + count)
+            Gone = 0x474D5343,          //!< "CSMG" - requested range [sequence, sequence + count) is not available
+            Cookie = 0x434D5343         //!< "CSMC" - subscriber cookie in the sequence field (unicast)
+        };
+
+        uint32_t type;
+        uint32_t count;
+        uint64_t sequence;
+    };
+
+    //! Retransmission request (NACK)
+    struct MulticastNack
+    {
+        MulticastHeader header;
+        uint64_t cookie;                //!< Subscriber cookie received from the publisher (0 - unknown)
+    };
+    #pragma pack(pop)
+
+    //! Maximal number of sequences requested or answered by a single NACK
+    const uint32_t MulticastNackLimit = 1024;
+
+}
@@ -0,0 +1,225 @@
+#include "stdafx.h"
+
+#include "SessionMonitor.h"
+
+namespace CSharpServer {
+
+    void SessionActivityEx::Snapshot(SessionSnapshotEx& snapshot)
+    {
+        _stats.Fill(snapshot);
+
+        int64_t last = std::max(_last_received.load(std::memory_order_relaxed), _last_sent.load(std::memory_order_relaxed));
+        snapshot.idle_time = (last > 0) ? (Now() - last) : 0;
+    }
+
+    void SessionActivityEx::Hold(const std::shared_ptr<HeldSessionsEx>& held, size_t memory)
+    {
+        Unhold();
+
+        _held = held;
+        _held_memory = memory;
+        ++_held->sessions;
+        _held->memory += memory;
+    }
+
+    void SessionActivityEx::Unhold()
+    {
+        if (!_held)
+            return;
+
+        --_held->sessions;
+        _held->memory -= _held_memory;
+        _held.reset();
+        _held_memory = 0;
+    }
+
+    void SessionMonitorEx::Register(const std::shared_ptr<SessionActivityEx>& session)
+    {
+        int64_t now = SessionActivityEx::Now();
+        session->_last_received = now;
+        session->_last_sent = now;
+        session->_last_timeout = now;
+        session->_last_heartbeat = now;
+
+        std::lock_guard<std::mutex> locker(_lock);
+
+        if (session->_monitor_index != (size_t)-1)
+            return;
+
+        session->_monitor_index = _sessions.size();
+        _sessions.push_back(session);
+    }
+
+    void SessionMonitorEx::Unregister(SessionActivityEx* session)
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        size_t index = session->_monitor_index;
+        if (index == (size_t)-1)
+            return;
+
+        // Swap with the last session to remove in O(1)
+        if (index != (_sessions.size() - 1))
+        {
+            _sessions[index] = std::move(_sessions.back());
+            _sessions[index]->_monitor_index = index;
+        }
+        _sessions.pop_back();
+        session->_monitor_index = (size_t)-1;
+    }
+
+    void SessionMonitorEx::Start(const std::shared_ptr<CppServer::Asio::Service>& service)
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        if (_started)
+            return;
+
+        _io_service = service->GetAsioService();
+        _timer = std::make_shared<asio::steady_timer>(*_io_service);
+        _cursor = 0;
+        _started = true;
+        ++_generation;
+
+        Arm();
+    }
+
+    void SessionMonitorEx::Stop()
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        if (!_started)
+            return;
+
+        _started = false;
+        _armed = false;
+        _timer->cancel();
+
+        for (auto& session : _sessions)
+            session->_monitor_index = (size_t)-1;
+        _sessions.clear();
+        _cursor = 0;
+    }
+
+    std::chrono::nanoseconds SessionMonitorEx::Period() const noexcept
+    {
+        // Sweep four times per the shortest timeout to keep the detection error below 25%
+        int64_t period = 0;
+        for (int64_t timeout : { _idle_timeout.load(), _read_timeout.load(), _heartbeat.load() })
+            if ((timeout > 0) && ((period == 0) || (timeout < period)))
+                period = timeout;
+        if (period == 0)
+            return std::chrono::nanoseconds(0);
+        period /= 4;
+
+        const int64_t lower = 10 * 1000 * 1000;
+        const int64_t upper = 1000 * 1000 * 1000;
+        return std::chrono::nanoseconds((period < lower) ? lower : ((period > upper) ? upper : period));
+    }
+
+    void SessionMonitorEx::Arm()
+    {
+        // Nothing to sweep without timeouts, the timer is armed again by the timeout setup
+        std::chrono::nanoseconds period = Period();
+        _armed = (period.count() > 0);
+        if (!_armed)
+            return;
+
+        _timer->expires_after(period);
+
+        auto self(this->shared_from_this());
+        auto timer(_timer);
+        uint64_t generation = _generation;
+        _timer->async_wait([this, self, timer, generation](const std::error_code& ec)
+        {
+            if (ec == asio::error::operation_aborted)
+                return;
+
+            Sweep(generation);
+        });
+    }
+
+    void SessionMonitorEx::Rearm()
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        if (!_started)
+            return;
+
+        // Handlers of the previous sweep chain are skipped by the generation
+        ++_generation;
+        _cursor = 0;
+        if (_armed)
+            _timer->cancel();
+        Arm();
+    }
+
+    void SessionMonitorEx::Sweep(uint64_t generation)
+    {
+        std::vector<std::pair<std::shared_ptr<SessionActivityEx>, int>> expired;
+        bool completed = true;
+        {
+            std::lock_guard<std::mutex> locker(_lock);
+
+            // Sweep chain of the previous start is stopped, the restarted monitor has its own
+            if (!_started || (generation != _generation))
+                return;
+
+            int64_t now = SessionActivityEx::Now();
+            int64_t idle_timeout = _idle_timeout;
+            int64_t read_timeout = _read_timeout;
+            int64_t heartbeat = _heartbeat;
+
+            if ((idle_timeout > 0) || (read_timeout > 0) || (heartbeat > 0))
+            {
+                for (size_t i = 0; (i < SweepBatch) && (_cursor < _sessions.size()); ++i, ++_cursor)
+                {
+                    auto& session = _sessions[_cursor];
+                    int64_t received = std::max(session->_last_received.load(std::memory_order_relaxed), session->_last_timeout.load(std::memory_order_relaxed));
+                    int64_t sent = session->_last_sent.load(std::memory_order_relaxed);
+
+                    // The same timeout is not reported again until it expires once more
+                    if ((read_timeout > 0) && ((now - received) >= read_timeout))
+                    {
+                        session->_last_timeout = now;
+                        expired.emplace_back(session, (int)SessionTimeout::Read);
+                    }
+                    else if ((idle_timeout > 0) && ((now - std::max(received, sent)) >= idle_timeout))
+                    {
+                        session->_last_timeout = now;
+                        expired.emplace_back(session, (int)SessionTimeout::Idle);
+                    }
+                    else if ((heartbeat > 0) && ((now - std::max(sent, session->_last_heartbeat.load(std::memory_order_relaxed))) >= heartbeat))
+                    {
+                        session->_last_heartbeat = now;
+                        expired.emplace_back(session, (int)SessionTimeout::Heartbeat);
+                    }
+                }
+            }
+
+            // Continue with the next batch right after other pending handlers
+            completed = (_cursor >= _sessions.size());
+            if (completed)
+            {
+                _cursor = 0;
+                Arm();
+            }
+        }
+
+        for (auto& item : expired)
+        {
+            if (item.second == (int)SessionTimeout::Heartbeat)
+                ++_heartbeats;
+            else
+                ++_timeouts;
+            item.first->onTimeout(item.second);
+        }
+
+        if (!completed)
+        {
+            auto self(this->shared_from_this());
+            _io_service->post([this, self, generation]() { Sweep(generation); });
+        }
+    }
+
+}
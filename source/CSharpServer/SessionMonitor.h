@@ -0,0 +1,160 @@
+#pragma once
+
+#include "SessionStats.h"
+
+#include <time/timespan.h>
+
+#include <vector>
+
+namespace CSharpServer {
+
+    //! Session timeout
+    public enum class SessionTimeout
+    {
+        //! Nothing was received or sent during the idle timeout
+        Idle,
+        //! Nothing was received during the read timeout
+        Read,
+        //! Nothing was sent during the heartbeat interval
+        Heartbeat
+    };
+
+    class SessionMonitorEx;
+
+    //! Held sessions
+    /*!
+        Accounting of disconnected sessions which still hold their native
+        resources, e.g. pooled sessions or sessions waiting for the managed
+        finalizer. Shared with sessions, so it outlives the server.
+    */
+    struct HeldSessionsEx
+    {
+        std::atomic<uint64_t> sessions{0};
+        std::atomic<uint64_t> memory{0};
+    };
+
+    //! Session activity
+    /*!
+        Last activity timestamps of the session tracked by the session monitor.
+        Timestamps are updated from I/O handlers without any locks.
+    */
+    class SessionActivityEx
+    {
+    public:
+        SessionActivityEx() = default;
+        SessionActivityEx(const SessionActivityEx&) = delete;
+        SessionActivityEx(SessionActivityEx&&) = delete;
+        virtual ~SessionActivityEx() { Unhold(); }
+
+        SessionActivityEx& operator=(const SessionActivityEx&) = delete;
+        SessionActivityEx& operator=(SessionActivityEx&&) = delete;
+
+        //! Update the last receive activity
+        void ActivityReceived() noexcept { _last_received.store(Now(), std::memory_order_relaxed); }
+        //! Update the last send activity
+        void ActivitySent() noexcept { _last_sent.store(Now(), std::memory_order_relaxed); }
+
+        //! Get the session statistics
+        SessionStatsEx& stats() noexcept { return _stats; }
+        //! Fill the statistics snapshot with the session activity
+        void Snapshot(SessionSnapshotEx& snapshot);
+
+        //! Account the disconnected session as held with the given native memory
+        void Hold(const std::shared_ptr<HeldSessionsEx>& held, size_t memory);
+        //! Remove the session from held sessions
+        void Unhold();
+        //! Is the pooled session reset and ready to be reused?
+        bool idle() const noexcept { return _idle.load(std::memory_order_acquire); }
+        //! Mark the pooled session as reset and ready to be reused
+        void SetIdle() noexcept { _idle.store(true, std::memory_order_release); }
+
+        //! Get the current monotonic time in nanoseconds
+        static int64_t Now() noexcept { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+        //! Handle session timeout notification
+        virtual void onTimeout(int timeout) = 0;
+
+    private:
+        friend class SessionMonitorEx;
+
+        std::atomic<int64_t> _last_received{0};
+        std::atomic<int64_t> _last_sent{0};
+        std::atomic<int64_t> _last_timeout{0};
+        std::atomic<int64_t> _last_heartbeat{0};
+        size_t _monitor_index{(size_t)-1};
+        std::shared_ptr<HeldSessionsEx> _held;
+        size_t _held_memory{0};
+        std::atomic<bool> _idle{false};
+        SessionStatsEx _stats;
+    };
+
+    //! Session monitor
+    /*!
+        Session monitor keeps the registry of connected sessions and sweeps
+        their activity timestamps on one of the service threads. Sweeping is
+        done in batches, so a large number of sessions does not block other
+        handlers of the service. Only timed out sessions are notified.
+    */
+    class SessionMonitorEx : public std::enable_shared_from_this<SessionMonitorEx>
+    {
+    public:
+        SessionMonitorEx() = default;
+        SessionMonitorEx(const SessionMonitorEx&) = delete;
+        SessionMonitorEx(SessionMonitorEx&&) = delete;
+        ~SessionMonitorEx() = default;
+
+        SessionMonitorEx& operator=(const SessionMonitorEx&) = delete;
+        SessionMonitorEx& operator=(SessionMonitorEx&&) = delete;
+
+        CppCommon::Timespan idle_timeout() const noexcept { return CppCommon::Timespan(_idle_timeout); }
+        CppCommon::Timespan read_timeout() const noexcept { return CppCommon::Timespan(_read_timeout); }
+        CppCommon::Timespan heartbeat() const noexcept { return CppCommon::Timespan(_heartbeat); }
+        uint64_t timeouts() const noexcept { return _timeouts; }
+        uint64_t heartbeats() const noexcept { return _heartbeats; }
+        //! Get the copy of registered sessions
+        std::vector<std::shared_ptr<SessionActivityEx>> sessions() { std::lock_guard<std::mutex> locker(_lock); return _sessions; }
+
+        void SetupIdleTimeout(const CppCommon::Timespan& timeout) { _idle_timeout = std::max(timeout.total(), (int64_t)0); Rearm(); }
+        void SetupReadTimeout(const CppCommon::Timespan& timeout) { _read_timeout = std::max(timeout.total(), (int64_t)0); Rearm(); }
+        void SetupHeartbeat(const CppCommon::Timespan& interval) { _heartbeat = std::max(interval.total(), (int64_t)0); Rearm(); }
+
+        //! Register the connected session
+        void Register(const std::shared_ptr<SessionActivityEx>& session);
+        //! Unregister the disconnected session
+        void Unregister(SessionActivityEx* session);
+
+        //! Start sweeping on the given service
+        void Start(const std::shared_ptr<CppServer::Asio::Service>& service);
+        //! Stop sweeping and clear the registry
+        void Stop();
+
+    private:
+        //! Number of sessions checked by one sweep handler
+        static const size_t SweepBatch = 4096;
+
+        std::mutex _lock;
+        std::shared_ptr<asio::io_service> _io_service;
+        std::shared_ptr<asio::steady_timer> _timer;
+        std::vector<std::shared_ptr<SessionActivityEx>> _sessions;
+        size_t _cursor{0};
+        bool _started{false};
+        bool _armed{false};
+        uint64_t _generation{0};
+
+        std::atomic<int64_t> _idle_timeout{0};
+        std::atomic<int64_t> _read_timeout{0};
+        std::atomic<int64_t> _heartbeat{0};
+        std::atomic<uint64_t> _timeouts{0};
+        std::atomic<uint64_t> _heartbeats{0};
+
+        //! Get the sweep period (zero if no timeout is configured)
+        std::chrono::nanoseconds Period() const noexcept;
+        //! Arm the sweep timer if any timeout is configured
+        void Arm();
+        //! Restart the sweep chain with the period of changed timeouts
+        void Rearm();
+        //! Sweep the next batch of sessions (handlers of the previous start are skipped)
+        void Sweep(uint64_t generation);
+    };
+
+}
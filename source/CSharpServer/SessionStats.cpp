@@ -0,0 +1,202 @@
+#include "stdafx.h"
+
+#include "SessionStats.h"
+
+namespace CSharpServer {
+
+    int64_t SessionSnapshotEx::Metric(int metric) const noexcept
+    {
+        switch (metric)
+        {
+            case (int)SessionMetric::MessagesReceived:
+                return (int64_t)messages_received;
+            case (int)SessionMetric::MessagesSent:
+                return (int64_t)messages_sent;
+            case (int)SessionMetric::BytesReceived:
+                return (int64_t)bytes_received;
+            case (int)SessionMetric::BytesSent:
+                return (int64_t)bytes_sent;
+            case (int)SessionMetric::BytesPending:
+                return (int64_t)bytes_pending;
+            case (int)SessionMetric::PendingHighWater:
+                return (int64_t)pending_high_water;
+            case (int)SessionMetric::PendingTime:
+                return pending_time;
+            case (int)SessionMetric::IdleTime:
+                return idle_time;
+            case (int)SessionMetric::SendLatency:
+                return send_latency_p99;
+            default:
+                return 0;
+        }
+    }
+
+    static int64_t StatsNow() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    uint64_t SessionStatsEx::Sending(size_t size)
+    {
+        if (!timing())
+            return 0;
+
+        int64_t now = StatsNow();
+
+        std::lock_guard<std::mutex> locker(_lock);
+
+        if (_pending_since == 0)
+            _pending_since = now;
+
+        // Sample the send only when there is a free slot, the offset is tracked anyway
+        _queued += size;
+        if ((_tail - _head) < Samples)
+            _samples[_tail++ % Samples] = Sample{ _queued, now };
+        return _queued;
+    }
+
+    void SessionStatsEx::Rollback(uint64_t offset, size_t size)
+    {
+        if ((offset == 0) || (size == 0))
+            return;
+
+        std::lock_guard<std::mutex> locker(_lock);
+
+        // Drop the sample of the message and shift samples of later messages back,
+        // so they still complete when their data is sent
+        for (size_t i = _head; i < _tail;)
+        {
+            Sample& sample = _samples[i % Samples];
+            if (sample.end == offset)
+            {
+                for (size_t j = i + 1; j < _tail; ++j)
+                    _samples[(j - 1) % Samples] = _samples[j % Samples];
+                --_tail;
+                continue;
+            }
+            if (sample.end > offset)
+                sample.end -= size;
+            ++i;
+        }
+        _queued -= size;
+
+        // Nothing else is pending
+        if (_queued == _completed)
+            _pending_since = 0;
+    }
+
+    void SessionStatsEx::Queued(size_t pending) noexcept
+    {
+        _messages_sent.fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t high_water = _pending_high_water.load(std::memory_order_relaxed);
+        while ((pending > high_water) && !_pending_high_water.compare_exchange_weak(high_water, pending, std::memory_order_relaxed));
+    }
+
+    void SessionStatsEx::Sent(size_t sent, size_t pending)
+    {
+        if (!timing())
+            return;
+
+        int64_t now = StatsNow();
+
+        std::lock_guard<std::mutex> locker(_lock);
+
+        // Complete sampled sends which are fully sent
+        _completed += sent;
+        while ((_head != _tail) && (_samples[_head % Samples].end <= _completed))
+        {
+            RecordLatency(now - _samples[_head % Samples].time);
+            ++_head;
+        }
+
+        if ((pending == 0) && (_pending_since != 0))
+        {
+            _pending_time += now - _pending_since;
+            _pending_since = 0;
+        }
+    }
+
+    void SessionStatsEx::Reset()
+    {
+        _messages_received = 0;
+        _messages_sent = 0;
+        _pending_high_water = 0;
+
+        std::lock_guard<std::mutex> locker(_lock);
+
+        _queued = 0;
+        _completed = 0;
+        _pending_since = 0;
+        _pending_time = 0;
+        _head = 0;
+        _tail = 0;
+        std::fill(std::begin(_latency), std::end(_latency), 0);
+        _latency_max = 0;
+    }
+
+    void SessionStatsEx::Fill(SessionSnapshotEx& snapshot)
+    {
+        snapshot.messages_received = _messages_received.load(std::memory_order_relaxed);
+        snapshot.messages_sent = _messages_sent.load(std::memory_order_relaxed);
+        snapshot.pending_high_water = _pending_high_water.load(std::memory_order_relaxed);
+
+        if (!timing())
+        {
+            snapshot.pending_time = 0;
+            snapshot.send_latency_p50 = 0;
+            snapshot.send_latency_p99 = 0;
+            snapshot.send_latency_max = 0;
+            return;
+        }
+
+        int64_t now = StatsNow();
+
+        std::lock_guard<std::mutex> locker(_lock);
+
+        snapshot.pending_time = _pending_time + ((_pending_since != 0) ? (now - _pending_since) : 0);
+        snapshot.send_latency_p50 = LatencyPercentile(50.0);
+        snapshot.send_latency_p99 = LatencyPercentile(99.0);
+        snapshot.send_latency_max = _latency_max;
+    }
+
+    void SessionStatsEx::RecordLatency(int64_t latency) noexcept
+    {
+        if (latency < 0)
+            latency = 0;
+
+        size_t index = 0;
+        while ((index < (LatencyBuckets - 1)) && ((latency >> (index + 1)) != 0))
+            ++index;
+
+        // Saturate the bucket instead of overflow
+        if (_latency[index] != 0xFFFFFFFF)
+            ++_latency[index];
+        if (latency > _latency_max)
+            _latency_max = latency;
+    }
+
+    int64_t SessionStatsEx::LatencyPercentile(double percentile) const noexcept
+    {
+        uint64_t count = 0;
+        for (uint32_t bucket : _latency)
+            count += bucket;
+        if (count == 0)
+            return 0;
+
+        uint64_t rank = std::max((uint64_t)((percentile / 100.0) * count + 0.5), (uint64_t)1);
+        uint64_t total = 0;
+        for (size_t i = 0; i < LatencyBuckets; ++i)
+        {
+            total += _latency[i];
+            if (total >= rank)
+            {
+                // Report the upper bound of the bucket, but never above the maximal latency
+                int64_t bound = ((int64_t)1 << (i + 1)) - 1;
+                return (bound < _latency_max) ? bound : _latency_max;
+            }
+        }
+        return _latency_max;
+    }
+
+}
@@ -0,0 +1,200 @@
+#pragma once
+
+#include "Service.h"
+
+namespace CSharpServer {
+
+    //! Session metric
+    public enum class SessionMetric
+    {
+        //! Number of received messages
+        MessagesReceived,
+        //! Number of sent messages
+        MessagesSent,
+        //! Number of received bytes
+        BytesReceived,
+        //! Number of sent bytes
+        BytesSent,
+        //! Number of bytes pending sent
+        BytesPending,
+        //! Send queue high-water mark
+        PendingHighWater,
+        //! Time spent with bytes pending sent
+        PendingTime,
+        //! Time since the last activity
+        IdleTime,
+        //! 99th percentile of the send latency
+        SendLatency
+    };
+
+    //! Session statistics snapshot
+    struct SessionSnapshotEx
+    {
+        uint64_t messages_received;
+        uint64_t messages_sent;
+        uint64_t bytes_received;
+        uint64_t bytes_sent;
+        uint64_t bytes_pending;
+        uint64_t pending_high_water;
+        int64_t pending_time;
+        int64_t idle_time;
+        int64_t send_latency_p50;
+        int64_t send_latency_p99;
+        int64_t send_latency_max;
+
+        //! Get the value of the given metric (SessionMetric) to compare sessions
+        int64_t Metric(int metric) const noexcept;
+    };
+
+    //! Session statistics
+    /*!
+        Per-session counters updated from I/O handlers without locks. Send timing
+        (send latency and pending time) is optional, because it takes the lock of
+        the session on each send and sent notification. Send latency is measured
+        from SendAsync() to the onSent() notification which completes the sent
+        data. It is sampled for up to 32 sends in flight and kept in a sketch of
+        power of two buckets, so percentiles are reported with the factor 2 error.
+    */
+    class SessionStatsEx
+    {
+    public:
+        SessionStatsEx() { Reset(); }
+        SessionStatsEx(const SessionStatsEx&) = delete;
+        SessionStatsEx(SessionStatsEx&&) = delete;
+        ~SessionStatsEx() = default;
+
+        SessionStatsEx& operator=(const SessionStatsEx&) = delete;
+        SessionStatsEx& operator=(SessionStatsEx&&) = delete;
+
+        //! Is send timing enabled?
+        bool timing() const noexcept { return _timing.load(std::memory_order_relaxed); }
+        //! Setup send timing (send latency and pending time)
+        void SetupTiming(bool enable) noexcept { _timing.store(enable, std::memory_order_relaxed); }
+
+        //! Count the received message
+        void Received() noexcept { _messages_received.fetch_add(1, std::memory_order_relaxed); }
+        //! Start timing of the message before SendAsync() hands it to the socket
+        /*!
+            The sample is taken before the data could be sent, so the onSent()
+            notification of the data never comes ahead of its sample.
+
+            \param size - Message size
+            \return End offset of the message to roll back its sample with Rollback() (0 if timing is disabled)
+        */
+        uint64_t Sending(size_t size);
+        //! Roll back the sample of the message which failed to be sent
+        /*!
+            \param offset - End offset of the message returned by Sending()
+            \param size - Message size
+        */
+        void Rollback(uint64_t offset, size_t size);
+        //! Count the message queued by SendAsync()
+        /*!
+            \param pending - Bytes pending after the message is queued
+        */
+        void Queued(size_t pending) noexcept;
+        //! Complete sent messages
+        /*!
+            \param sent - Size of sent buffer
+            \param pending - Bytes still pending sent
+        */
+        void Sent(size_t sent, size_t pending);
+        //! Reset all statistics
+        void Reset();
+
+        //! Fill statistics counters of the snapshot
+        void Fill(SessionSnapshotEx& snapshot);
+
+    private:
+        static const size_t Samples = 32;
+        static const size_t LatencyBuckets = 48;
+
+        struct Sample
+        {
+            uint64_t end;
+            int64_t time;
+        };
+
+        std::atomic<uint64_t> _messages_received;
+        std::atomic<uint64_t> _messages_sent;
+        std::atomic<uint64_t> _pending_high_water;
+        std::atomic<bool> _timing{false};
+
+        std::mutex _lock;
+        uint64_t _queued;
+        uint64_t _completed;
+        int64_t _pending_since;
+        int64_t _pending_time;
+        Sample _samples[Samples];
+        size_t _head;
+        size_t _tail;
+        uint32_t _latency[LatencyBuckets];
+        int64_t _latency_max;
+
+        void RecordLatency(int64_t latency) noexcept;
+        int64_t LatencyPercentile(double percentile) const noexcept;
+    };
+
+    //! Session statistics
+    /*!
+        Snapshot of the session statistics. Counters are read without locks,
+        so they could be slightly inconsistent with each other. Pending time and
+        send latencies are zero unless the server is setup with session send
+        timing (see SetupSessionTiming()).
+    */
+    public value struct SessionStats
+    {
+    public:
+        //! Get the number of received messages (receive notifications)
+        property long long MessagesReceived { long long get() { return _messages_received; } }
+        //! Get the number of sent messages (successful SendAsync() calls)
+        property long long MessagesSent { long long get() { return _messages_sent; } }
+        //! Get the number of received bytes
+        property long long BytesReceived { long long get() { return _bytes_received; } }
+        //! Get the number of sent bytes
+        property long long BytesSent { long long get() { return _bytes_sent; } }
+        //! Get the number of bytes pending sent
+        property long long BytesPending { long long get() { return _bytes_pending; } }
+        //! Get the send queue high-water mark in bytes
+        property long long PendingHighWater { long long get() { return _pending_high_water; } }
+        //! Get the time spent with bytes pending sent
+        property TimeSpan PendingTime { TimeSpan get() { return TimeSpan(_pending_time / 100); } }
+        //! Get the time since the last receive or send activity
+        property TimeSpan IdleTime { TimeSpan get() { return TimeSpan(_idle_time / 100); } }
+        //! Get the median send latency
+        property TimeSpan SendLatencyP50 { TimeSpan get() { return TimeSpan(_send_latency_p50 / 100); } }
+        //! Get the 99th percentile of the send latency
+        property TimeSpan SendLatencyP99 { TimeSpan get() { return TimeSpan(_send_latency_p99 / 100); } }
+        //! Get the maximal send latency
+        property TimeSpan SendLatencyMax { TimeSpan get() { return TimeSpan(_send_latency_max / 100); } }
+
+    internal:
+        SessionStats(const SessionSnapshotEx& snapshot) :
+            _messages_received((long long)snapshot.messages_received),
+            _messages_sent((long long)snapshot.messages_sent),
+            _bytes_received((long long)snapshot.bytes_received),
+            _bytes_sent((long long)snapshot.bytes_sent),
+            _bytes_pending((long long)snapshot.bytes_pending),
+            _pending_high_water((long long)snapshot.pending_high_water),
+            _pending_time(snapshot.pending_time),
+            _idle_time(snapshot.idle_time),
+            _send_latency_p50(snapshot.send_latency_p50),
+            _send_latency_p99(snapshot.send_latency_p99),
+            _send_latency_max(snapshot.send_latency_max)
+        {}
+
+    private:
+        long long _messages_received;
+        long long _messages_sent;
+        long long _bytes_received;
+        long long _bytes_sent;
+        long long _bytes_pending;
+        long long _pending_high_water;
+        long long _pending_time;
+        long long _idle_time;
+        long long _send_latency_p50;
+        long long _send_latency_p99;
+        long long _send_latency_max;
+    };
+
+}
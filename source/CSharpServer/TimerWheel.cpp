@@ -0,0 +1,287 @@
+#include "stdafx.h"
+
+#include "TimerWheel.h"
+
+namespace CSharpServer {
+
+    TimerWheelEx::TimerWheelEx(const std::shared_ptr<CppServer::Asio::Service>& service, const CppCommon::Timespan& resolution) :
+        _io_service(service->GetAsioService()),
+        _timer(*_io_service),
+        _resolution(resolution),
+        _tick(std::max(resolution.nanoseconds(), (int64_t)1)),
+        _epoch(std::chrono::steady_clock::now())
+    {
+        std::fill(std::begin(_slots), std::end(_slots), Nil);
+    }
+
+    uint64_t TimerWheelEx::Schedule(const CppCommon::Timespan& delay, int64_t data)
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        // Nothing to expire, so the wheel can jump to the current tick
+        if (_count == 0)
+            _now = std::max(_now, Now());
+
+        // Take the node from the free list or grow the pool
+        uint32_t index;
+        if (_free != Nil)
+        {
+            index = _free;
+            _free = _nodes[index].next;
+        }
+        else
+        {
+            index = (uint32_t)_nodes.size();
+            _nodes.push_back(Node{ 0, 0, 1, Nil, Nil, 0, false });
+        }
+
+        uint64_t ticks = (uint64_t)((std::max(delay.nanoseconds(), (int64_t)0) + _tick.count() - 1) / _tick.count());
+
+        Node& node = _nodes[index];
+        node.expire = std::max(Now() + ticks, _now + 1);
+        node.data = data;
+        node.active = true;
+        Link(index);
+        ++_count;
+
+        Arm();
+
+        return ((uint64_t)node.generation << 32) | index;
+    }
+
+    bool TimerWheelEx::Reschedule(uint64_t handle, const CppCommon::Timespan& delay)
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        Node* node = Find(handle);
+        if (node == nullptr)
+            return false;
+
+        uint32_t index = (uint32_t)(handle & 0xFFFFFFFF);
+        uint64_t ticks = (uint64_t)((std::max(delay.nanoseconds(), (int64_t)0) + _tick.count() - 1) / _tick.count());
+
+        Unlink(index);
+        node->expire = std::max(Now() + ticks, _now + 1);
+        Link(index);
+
+        return true;
+    }
+
+    bool TimerWheelEx::Cancel(uint64_t handle)
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        if (Find(handle) == nullptr)
+            return false;
+
+        uint32_t index = (uint32_t)(handle & 0xFFFFFFFF);
+        Unlink(index);
+        Release(index);
+
+        return true;
+    }
+
+    void TimerWheelEx::Clear()
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        // Invalidate all handles of active timers
+        _free = Nil;
+        for (size_t i = _nodes.size(); i-- > 0;)
+        {
+            Node& node = _nodes[i];
+            if (node.active)
+            {
+                node.active = false;
+                if (++node.generation == 0)
+                    node.generation = 1;
+            }
+            node.next = _free;
+            _free = (uint32_t)i;
+        }
+
+        std::fill(std::begin(_slots), std::end(_slots), Nil);
+        _count = 0;
+
+        if (_armed)
+        {
+            _armed = false;
+            _timer.cancel();
+        }
+    }
+
+    uint64_t TimerWheelEx::Now() const noexcept
+    {
+        return (uint64_t)((std::chrono::steady_clock::now() - _epoch) / _tick);
+    }
+
+    void TimerWheelEx::Link(uint32_t index)
+    {
+        Node& node = _nodes[index];
+
+        // Timers beyond the wheel range are parked in the last slot of the range
+        // keeping their deadline, so they are linked again when the slot cascades
+        uint64_t expire = node.expire;
+        uint64_t delta = expire - _now;
+        if (delta >= ((uint64_t)1 << (Levels * SlotBits)))
+        {
+            delta = ((uint64_t)1 << (Levels * SlotBits)) - 1;
+            expire = _now + delta;
+        }
+
+        size_t level = 0;
+        while ((level < (Levels - 1)) && (delta >= ((uint64_t)1 << ((level + 1) * SlotBits))))
+            ++level;
+
+        size_t slot = level * Slots + (size_t)((expire >> (level * SlotBits)) & SlotMask);
+
+        node.slot = (uint16_t)slot;
+        node.prev = Nil;
+        node.next = _slots[slot];
+        if (node.next != Nil)
+            _nodes[node.next].prev = index;
+        _slots[slot] = index;
+    }
+
+    void TimerWheelEx::Unlink(uint32_t index)
+    {
+        Node& node = _nodes[index];
+
+        if (node.prev != Nil)
+            _nodes[node.prev].next = node.next;
+        else
+            _slots[node.slot] = node.next;
+        if (node.next != Nil)
+            _nodes[node.next].prev = node.prev;
+    }
+
+    void TimerWheelEx::Release(uint32_t index)
+    {
+        Node& node = _nodes[index];
+
+        node.active = false;
+        if (++node.generation == 0)
+            node.generation = 1;
+        node.next = _free;
+        _free = index;
+        --_count;
+    }
+
+    TimerWheelEx::Node* TimerWheelEx::Find(uint64_t handle)
+    {
+        uint32_t index = (uint32_t)(handle & 0xFFFFFFFF);
+        uint32_t generation = (uint32_t)(handle >> 32);
+
+        if (index >= _nodes.size())
+            return nullptr;
+
+        Node& node = _nodes[index];
+        return (node.active && (node.generation == generation)) ? &node : nullptr;
+    }
+
+    void TimerWheelEx::Advance(uint64_t now)
+    {
+        while (_now < now)
+        {
+            // Nothing to expire, so skip the rest of ticks
+            if (_count == 0)
+            {
+                _now = now;
+                break;
+            }
+
+            ++_now;
+
+            // Cascade timers of higher levels into lower ones
+            for (size_t level = Levels - 1; level > 0; --level)
+            {
+                if ((_now & (((uint64_t)1 << (level * SlotBits)) - 1)) != 0)
+                    continue;
+
+                size_t slot = level * Slots + (size_t)((_now >> (level * SlotBits)) & SlotMask);
+                uint32_t index = _slots[slot];
+                _slots[slot] = Nil;
+                while (index != Nil)
+                {
+                    uint32_t next = _nodes[index].next;
+                    Link(index);
+                    index = next;
+                }
+            }
+
+            // Expire timers of the current tick
+            size_t slot = (size_t)(_now & SlotMask);
+            uint32_t index = _slots[slot];
+            _slots[slot] = Nil;
+            while (index != Nil)
+            {
+                Node& node = _nodes[index];
+                uint32_t next = node.next;
+                _expired.push_back(Expired{ ((uint64_t)node.generation << 32) | index, node.data });
+                Release(index);
+                index = next;
+            }
+        }
+    }
+
+    void TimerWheelEx::Arm()
+    {
+        if (_armed || (_count == 0))
+            return;
+
+        _armed = true;
+        _timer.expires_at(_epoch + _tick * (int64_t)(_now + 1));
+
+        auto self(this->shared_from_this());
+        _timer.async_wait([this, self](const std::error_code& ec)
+        {
+            if (ec == asio::error::operation_aborted)
+                return;
+
+            Tick();
+        });
+    }
+
+    void TimerWheelEx::Tick()
+    {
+        std::vector<Expired> expired;
+        {
+            std::lock_guard<std::mutex> locker(_lock);
+
+            _armed = false;
+            Advance(Now());
+            std::swap(expired, _expired);
+            Arm();
+        }
+
+        if (!expired.empty())
+            onExpired(expired);
+    }
+
+    void TimerWheelEx::onExpired(const std::vector<Expired>& expired)
+    {
+        int count = (int)expired.size();
+        array<long long>^ handles = gcnew array<long long>(count);
+        array<long long>^ data = gcnew array<long long>(count);
+        for (int i = 0; i < count; ++i)
+        {
+            handles[i] = (long long)expired[i].handle;
+            data[i] = (long long)expired[i].data;
+        }
+        _metrics->trace()->Record(TraceEx::Expired, (uint64_t)count);
+
+        auto& profiler = _metrics->profiler();
+        int64_t start = profiler.Begin();
+        root->InternalOnExpired(handles, data, count);
+        profiler.End((int)CallbackType::Expired, start);
+    }
+
+    TimerWheel::TimerWheel(CSharpServer::Service^ service, TimeSpan resolution) :
+        _service(service),
+        _wheel(new std::shared_ptr<TimerWheelEx>(std::make_shared<TimerWheelEx>(service->_service.Value, CppCommon::Timespan(resolution.Ticks * 100))))
+    {
+        _wheel->get()->root = this;
+        _wheel->get()->SetupMetrics(service->_service->get()->metrics());
+    }
+
+}
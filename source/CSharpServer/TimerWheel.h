@@ -0,0 +1,184 @@
+#pragma once
+
+#include "Metrics.h"
+
+#include <time/timespan.h>
+
+#include <vector>
+
+namespace CSharpServer {
+
+    ref class TimerWheel;
+
+    //! Hierarchical timing wheel
+    /*!
+        Timers are kept in 4 levels of 256 slots with intrusive lists, so schedule
+        and cancel are O(1) and a timer costs one pool entry instead of an asio
+        deadline timer. The wheel is driven by a single asio timer of the service,
+        which is armed only while there are scheduled timers.
+    */
+    class TimerWheelEx : public std::enable_shared_from_this<TimerWheelEx>
+    {
+    public:
+        //! Expired timer
+        struct Expired
+        {
+            uint64_t handle;
+            int64_t data;
+        };
+
+        TimerWheelEx(const std::shared_ptr<CppServer::Asio::Service>& service, const CppCommon::Timespan& resolution);
+        TimerWheelEx(const TimerWheelEx&) = delete;
+        TimerWheelEx(TimerWheelEx&&) = delete;
+        ~TimerWheelEx() = default;
+
+        TimerWheelEx& operator=(const TimerWheelEx&) = delete;
+        TimerWheelEx& operator=(TimerWheelEx&&) = delete;
+
+        gcroot<TimerWheel^> root;
+
+        size_t count() const noexcept { return _count; }
+        const CppCommon::Timespan& resolution() const noexcept { return _resolution; }
+
+        //! Setup the metrics registry to profile expired timers callbacks
+        void SetupMetrics(const std::shared_ptr<MetricsEx>& metrics) noexcept { _metrics = metrics; }
+
+        //! Schedule the timer with a given delay and user data
+        /*!
+            \param delay - Expiry delay (rounded up to the wheel resolution)
+            \param data - User data reported on expiry
+            \return Timer handle (never zero)
+        */
+        uint64_t Schedule(const CppCommon::Timespan& delay, int64_t data);
+        //! Reschedule the active timer with a new delay keeping its handle
+        bool Reschedule(uint64_t handle, const CppCommon::Timespan& delay);
+        //! Cancel the active timer
+        bool Cancel(uint64_t handle);
+        //! Cancel all active timers
+        void Clear();
+
+        void onExpired(const std::vector<Expired>& expired);
+
+    private:
+        static const size_t Levels = 4;
+        static const size_t SlotBits = 8;
+        static const size_t Slots = (size_t)1 << SlotBits;
+        static const size_t SlotMask = Slots - 1;
+        static const uint32_t Nil = 0xFFFFFFFF;
+
+        struct Node
+        {
+            uint64_t expire;
+            int64_t data;
+            uint32_t generation;
+            uint32_t prev;
+            uint32_t next;
+            uint16_t slot;
+            bool active;
+        };
+
+        std::shared_ptr<MetricsEx> _metrics;
+        std::shared_ptr<asio::io_service> _io_service;
+        asio::steady_timer _timer;
+        CppCommon::Timespan _resolution;
+        std::chrono::nanoseconds _tick;
+
+        std::mutex _lock;
+        std::vector<Node> _nodes;
+        uint32_t _free{Nil};
+        uint32_t _slots[Levels * Slots];
+        uint64_t _now{0};
+        std::chrono::steady_clock::time_point _epoch;
+        std::atomic<size_t> _count{0};
+        bool _armed{false};
+        std::vector<Expired> _expired;
+
+        uint64_t Now() const noexcept;
+        void Link(uint32_t index);
+        void Unlink(uint32_t index);
+        void Release(uint32_t index);
+        Node* Find(uint64_t handle);
+        void Advance(uint64_t now);
+        void Arm();
+        void Tick();
+    };
+
+    //! Timer wheel
+    /*!
+        Timer wheel is used to manage a large number of timeouts (e.g. per-session
+        idle, heartbeat and request timeouts) with a cheap integer handle per timer.
+        Expired timers are reported in batches with OnExpired() notification.
+
+        Thread-safe.
+    */
+    public ref class TimerWheel
+    {
+    public:
+        //! Initialize timer wheel with a given service and 1 millisecond resolution
+        /*!
+            \param service - Service
+        */
+        TimerWheel(Service^ service) : TimerWheel(service, TimeSpan::FromMilliseconds(1)) {}
+        //! Initialize timer wheel with a given service and resolution
+        /*!
+            \param service - Service
+            \param resolution - Wheel tick resolution
+        */
+        TimerWheel(Service^ service, TimeSpan resolution);
+        ~TimerWheel() { this->!TimerWheel(); }
+
+        //! Get the service
+        property Service^ Service { CSharpServer::Service^ get() { return _service; } }
+
+        //! Get the number of scheduled timers
+        property long long Count { long long get() { return (long long)_wheel->get()->count(); } }
+        //! Get the wheel tick resolution
+        property TimeSpan Resolution { TimeSpan get() { return TimeSpan(_wheel->get()->resolution().nanoseconds() / 100); } }
+
+        //! Schedule the timer
+        /*!
+            \param delay - Expiry delay relative to now
+            \param data - User data reported on expiry (e.g. session index)
+            \return Timer handle
+        */
+        long long Schedule(TimeSpan delay, long long data) { return (long long)_wheel->get()->Schedule(CppCommon::Timespan(delay.Ticks * 100), data); }
+        //! Reschedule the active timer with a new delay
+        /*!
+            \param handle - Timer handle
+            \param delay - New expiry delay relative to now
+            \return 'true' if the timer was successfully rescheduled, 'false' if the timer is already expired or canceled
+        */
+        bool Reschedule(long long handle, TimeSpan delay) { return _wheel->get()->Reschedule((uint64_t)handle, CppCommon::Timespan(delay.Ticks * 100)); }
+        //! Cancel the active timer
+        /*!
+            \param handle - Timer handle
+            \return 'true' if the timer was successfully canceled, 'false' if the timer is already expired or canceled
+        */
+        bool Cancel(long long handle) { return _wheel->get()->Cancel((uint64_t)handle); }
+        //! Cancel all active timers
+        void Clear() { return _wheel->get()->Clear(); }
+
+    protected:
+        //! Handle expired timers notification
+        /*!
+            Notification is called from one of the service threads with the batch
+            of timers expired on the same wheel tick.
+
+            \param handles - Expired timer handles
+            \param data - User data of expired timers
+            \param count - Count of expired timers
+        */
+        virtual void OnExpired(array<long long>^ handles, array<long long>^ data, int count) {}
+
+    internal:
+        void InternalOnExpired(array<long long>^ handles, array<long long>^ data, int count) { OnExpired(handles, data, count); }
+
+    protected:
+        !TimerWheel() { _wheel->get()->Clear(); _wheel.Release(); }
+
+    private:
+        CSharpServer::Service^ _service;
+        Embedded<std::shared_ptr<TimerWheelEx>> _wheel;
+    };
+
+}
@@ -0,0 +1,191 @@
+#include "stdafx.h"
+
+#include "TokenBucket.h"
+
+namespace CSharpServer {
+
+    void TokenBucketEx::Setup(uint64_t rate, uint64_t burst) noexcept
+    {
+        _rate = rate;
+        _burst = std::max(burst, (uint64_t)1);
+        _tat = 0;
+    }
+
+    bool TokenBucketEx::Consume(size_t size) noexcept
+    {
+        uint64_t rate = _rate.load(std::memory_order_relaxed);
+        if (rate == 0)
+            return true;
+
+        int64_t now = Now();
+        int64_t cost = (int64_t)((double)size * 1000000000.0 / rate);
+        int64_t tolerance = (int64_t)((double)_burst.load(std::memory_order_relaxed) * 1000000000.0 / rate);
+
+        int64_t tat = _tat.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            if ((tat - now) > tolerance)
+            {
+                _throttled.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            if (_tat.compare_exchange_weak(tat, std::max(tat, now) + cost, std::memory_order_relaxed))
+                return true;
+        }
+    }
+
+    bool TokenBucketEx::Available() const noexcept
+    {
+        uint64_t rate = _rate.load(std::memory_order_relaxed);
+        if (rate == 0)
+            return true;
+
+        int64_t tolerance = (int64_t)((double)_burst.load(std::memory_order_relaxed) * 1000000000.0 / rate);
+        return (_tat.load(std::memory_order_relaxed) - Now()) <= tolerance;
+    }
+
+    int64_t TokenBucketEx::Delay() const noexcept
+    {
+        uint64_t rate = _rate.load(std::memory_order_relaxed);
+        if (rate == 0)
+            return 0;
+
+        int64_t tolerance = (int64_t)((double)_burst.load(std::memory_order_relaxed) * 1000000000.0 / rate);
+        int64_t delay = _tat.load(std::memory_order_relaxed) - tolerance - Now();
+        return (delay > 0) ? delay : 0;
+    }
+
+    void ReceiveThrottleEx::Attach(const std::shared_ptr<asio::io_service>& service, const std::weak_ptr<void>& owner, TokenBucketEx& limit, ReceiveDelayEx& delay, const Handler& handler)
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        // Timer is bound to the service of the previous connection
+        if (_service != service)
+            _timer.reset();
+
+        _service = service;
+        _owner = owner;
+        _limit = &limit;
+        _delay = &delay;
+        _handler = handler;
+        _enabled.store(true, std::memory_order_release);
+    }
+
+    void ReceiveThrottleEx::Detach()
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        _enabled.store(false, std::memory_order_release);
+
+        // Drop delayed data which cannot be delivered anymore
+        ++_generation;
+        if (_armed)
+        {
+            _armed = false;
+            _timer->cancel();
+        }
+        if (_delay != nullptr)
+            _delay->delayed -= _buffer.size();
+        _buffer.clear();
+        _buffer.shrink_to_fit();
+        _pending = 0;
+        _delivering = false;
+    }
+
+    bool ReceiveThrottleEx::Receive(const void* buffer, size_t size)
+    {
+        {
+            std::lock_guard<std::mutex> locker(_lock);
+
+            if (!enabled())
+                return true;
+
+            // Data received after delayed data waits for it to keep the order
+            bool delayed = !_buffer.empty() || _delivering;
+            if (delayed || !_limit->Consume(size))
+            {
+                if ((_buffer.size() + size) > _delay->session_limit)
+                    return false;
+                if ((_delay->delayed += size) > _delay->server_limit)
+                {
+                    _delay->delayed -= size;
+                    return false;
+                }
+
+                const uint8_t* bytes = (const uint8_t*)buffer;
+                _buffer.insert(_buffer.end(), bytes, bytes + size);
+                _pending = _buffer.size();
+                if (!_delivering)
+                    ArmTimer();
+                return true;
+            }
+        }
+
+        _handler(buffer, size);
+        return true;
+    }
+
+    void ReceiveThrottleEx::ArmTimer()
+    {
+        if (_armed)
+            return;
+
+        auto owner = _owner.lock();
+        if (!owner)
+            return;
+
+        if (!_timer)
+            _timer = std::make_shared<asio::steady_timer>(*_service);
+
+        _armed = true;
+        _timer->expires_after(std::chrono::nanoseconds(_limit->Delay()));
+
+        uint64_t generation = _generation;
+        auto timer(_timer);
+        _timer->async_wait([this, owner, timer, generation](const std::error_code& ec)
+        {
+            if (ec != asio::error::operation_aborted)
+                Deliver(generation);
+        });
+    }
+
+    void ReceiveThrottleEx::Deliver(uint64_t generation)
+    {
+        std::vector<uint8_t> data;
+        {
+            std::lock_guard<std::mutex> locker(_lock);
+
+            if (!enabled() || (generation != _generation))
+                return;
+
+            _armed = false;
+            if (_buffer.empty())
+                return;
+
+            // Wait for the limit to refill once more
+            if (!_limit->Consume(_buffer.size()))
+            {
+                ArmTimer();
+                return;
+            }
+
+            data.swap(_buffer);
+            _delay->delayed -= data.size();
+            _pending = 0;
+            _delivering = true;
+        }
+
+        _handler(data.data(), data.size());
+
+        std::lock_guard<std::mutex> locker(_lock);
+
+        if (generation != _generation)
+            return;
+
+        // Data received during the delivery waits for the next refill
+        _delivering = false;
+        if (!_buffer.empty())
+            ArmTimer();
+    }
+
+}
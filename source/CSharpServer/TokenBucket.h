@@ -0,0 +1,149 @@
+#pragma once
+
+#include "Service.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace CSharpServer {
+
+    //! Lock-free token bucket
+    /*!
+        Token bucket is implemented with the generic cell rate algorithm which
+        keeps only the theoretical arrival time of the next byte, so consuming
+        is a single compare-and-swap and can be done from any thread.
+
+        Bucket with zero rate is unlimited.
+    */
+    class TokenBucketEx
+    {
+    public:
+        TokenBucketEx() = default;
+        TokenBucketEx(const TokenBucketEx&) = delete;
+        TokenBucketEx(TokenBucketEx&&) = delete;
+        ~TokenBucketEx() = default;
+
+        TokenBucketEx& operator=(const TokenBucketEx&) = delete;
+        TokenBucketEx& operator=(TokenBucketEx&&) = delete;
+
+        uint64_t rate() const noexcept { return _rate; }
+        uint64_t burst() const noexcept { return _burst; }
+        uint64_t throttled() const noexcept { return _throttled; }
+
+        //! Setup the bucket rate and burst size
+        /*!
+            \param rate - Rate in bytes per second (0 - unlimited)
+            \param burst - Burst size in bytes (bucket capacity)
+        */
+        void Setup(uint64_t rate, uint64_t burst) noexcept;
+
+        //! Try to consume the given number of bytes
+        /*!
+            Any chunk is consumed while the bucket is not empty, so a single
+            chunk bigger than the burst size is not throttled forever. The
+            bucket goes into debt which is repaid before the next consume.
+
+            \param size - Number of bytes
+            \return 'true' if bytes were consumed, 'false' if the bucket is throttled
+        */
+        bool Consume(size_t size) noexcept;
+        //! Is the bucket allowed to consume (the bucket is not throttled)?
+        bool Available() const noexcept;
+        //! Get the delay in nanoseconds until the bucket allows to consume again
+        int64_t Delay() const noexcept;
+        //! Is the bucket full (the state could be dropped)?
+        bool IsFull() const noexcept { return _tat.load(std::memory_order_relaxed) <= Now(); }
+
+        //! Get the current monotonic time in nanoseconds
+        static int64_t Now() noexcept { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+    private:
+        std::atomic<uint64_t> _rate{0};
+        std::atomic<uint64_t> _burst{0};
+        std::atomic<int64_t> _tat{0};
+        std::atomic<uint64_t> _throttled{0};
+    };
+
+    //! Delayed receive data of all sessions of the server
+    struct ReceiveDelayEx
+    {
+        //! Max number of delayed bytes of one session
+        std::atomic<size_t> session_limit{4 * 1024 * 1024};
+        //! Max number of delayed bytes of all sessions
+        std::atomic<size_t> server_limit{64 * 1024 * 1024};
+        //! Number of delayed bytes of all sessions
+        std::atomic<size_t> delayed{0};
+    };
+
+    //! Receive throttle
+    /*!
+        Delays the delivery of received data while the shared receive limit of
+        the server is throttled instead of disconnecting the session. Data
+        received in the meantime is kept in order and delivered from the timer
+        once the limit refills. The socket is still read while the data is
+        delayed, so the delayed data is bounded per session and server-wide by
+        the shared ReceiveDelayEx limits.
+
+        Thread-safe.
+    */
+    class ReceiveThrottleEx
+    {
+    public:
+        //! Handler of the delivered data
+        typedef std::function<void(const void*, size_t)> Handler;
+
+        ReceiveThrottleEx() = default;
+        ReceiveThrottleEx(const ReceiveThrottleEx&) = delete;
+        ReceiveThrottleEx(ReceiveThrottleEx&&) = delete;
+        ~ReceiveThrottleEx() = default;
+
+        ReceiveThrottleEx& operator=(const ReceiveThrottleEx&) = delete;
+        ReceiveThrottleEx& operator=(ReceiveThrottleEx&&) = delete;
+
+        bool enabled() const noexcept { return _enabled.load(std::memory_order_acquire); }
+        //! Get the number of delayed bytes
+        size_t pending() const noexcept { return _pending.load(std::memory_order_relaxed); }
+
+        //! Attach the throttle to the connected session
+        /*!
+            \param service - Asio service of the owner
+            \param owner - Owner of the throttle (kept alive while the delay timer is armed)
+            \param limit - Shared receive limit (must outlive the owner)
+            \param delay - Shared delayed data limits (must outlive the owner)
+            \param handler - Handler of the delivered data
+        */
+        void Attach(const std::shared_ptr<asio::io_service>& service, const std::weak_ptr<void>& owner, TokenBucketEx& limit, ReceiveDelayEx& delay, const Handler& handler);
+        //! Detach the throttle from the disconnected owner and drop delayed data
+        void Detach();
+
+        //! Receive data through the throttle
+        /*!
+            \param buffer - Received buffer
+            \param size - Received buffer size
+            \return 'true' if the data was delivered or delayed, 'false' if the delayed data would exceed the session or server limit
+        */
+        bool Receive(const void* buffer, size_t size);
+
+    private:
+        std::mutex _lock;
+        std::atomic<bool> _enabled{false};
+        std::shared_ptr<asio::io_service> _service;
+        std::weak_ptr<void> _owner;
+        TokenBucketEx* _limit{nullptr};
+        ReceiveDelayEx* _delay{nullptr};
+        Handler _handler;
+        std::vector<uint8_t> _buffer;
+        std::atomic<size_t> _pending{0};
+        std::shared_ptr<asio::steady_timer> _timer;
+        bool _armed{false};
+        bool _delivering{false};
+        uint64_t _generation{0};
+
+        //! Arm the timer to deliver delayed data once the limit refills
+        void ArmTimer();
+        //! Deliver delayed data if the limit allows
+        void Deliver(uint64_t generation);
+    };
+
+}
@@ -0,0 +1,149 @@
+#include "stdafx.h"
+
+#include "Trace.h"
+
+#include <threads/thread.h>
+
+#include <algorithm>
+
+#pragma managed(push,off)
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace CSharpServer {
+
+    static uint64_t TraceTimestamp() noexcept
+    {
+#if defined(_M_IX86) || defined(_M_X64)
+        return __rdtsc();
+#else
+        LARGE_INTEGER counter;
+        ::QueryPerformanceCounter(&counter);
+        return (uint64_t)counter.QuadPart;
+#endif
+    }
+
+}
+#pragma managed(pop)
+
+namespace CSharpServer {
+
+    static int64_t TraceNow() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    TraceEx::TraceEx() :
+        _start_tsc(TraceTimestamp()),
+        _start_ns(TraceNow())
+    {
+        for (Ring& ring : _rings)
+            ring.slots.reset(new Slot[RingSize]());
+    }
+
+    uint64_t TraceEx::events() const noexcept
+    {
+        uint64_t result = 0;
+        for (const Ring& ring : _rings)
+            result += ring.head.load(std::memory_order_relaxed);
+        return result;
+    }
+
+    uint64_t TraceEx::Id(const CppCommon::UUID& id) noexcept
+    {
+        uint64_t result = 0;
+        for (size_t i = 0; i < 8; ++i)
+            result = (result << 8) | id.data()[i];
+        return result;
+    }
+
+    void TraceEx::Write(Type type, uint64_t id, uint64_t value) noexcept
+    {
+        Ring& ring = _rings[std::hash<std::thread::id>()(std::this_thread::get_id()) % Rings];
+
+        uint64_t index = ring.head.fetch_add(1, std::memory_order_relaxed);
+        Slot& slot = ring.slots[index & (RingSize - 1)];
+
+        // Invalidate the slot for readers while the event is written
+        slot.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.event.timestamp = TraceTimestamp();
+        slot.event.id = id;
+        slot.event.value = value;
+        slot.event.thread = (uint32_t)CppCommon::Thread::CurrentThreadId();
+        slot.event.type = type;
+        slot.event.reserved = 0;
+        slot.sequence.store(index + 1, std::memory_order_release);
+    }
+
+    std::vector<TraceEventEx> TraceEx::Snapshot() const
+    {
+        std::vector<TraceEventEx> events;
+        events.reserve(capacity());
+
+        for (const Ring& ring : _rings)
+        {
+            uint64_t head = ring.head.load(std::memory_order_acquire);
+            uint64_t tail = (head > RingSize) ? (head - RingSize) : 0;
+            for (uint64_t index = tail; index < head; ++index)
+            {
+                const Slot& slot = ring.slots[index & (RingSize - 1)];
+
+                // Skip the event which is being written or already overwritten
+                uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+                if (sequence != (index + 1))
+                    continue;
+                TraceEventEx event = slot.event;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+                    continue;
+
+                events.push_back(event);
+            }
+        }
+
+        std::sort(events.begin(), events.end(), [](const TraceEventEx& a, const TraceEventEx& b) { return a.timestamp < b.timestamp; });
+        return events;
+    }
+
+    template <typename T>
+    static void TraceWrite(std::string& buffer, T value)
+    {
+        // All Windows targets are little-endian, so values are written as is
+        buffer.append((const char*)&value, sizeof(T));
+    }
+
+    std::string TraceEx::Dump() const
+    {
+        std::vector<TraceEventEx> events = Snapshot();
+
+        std::string buffer;
+        buffer.reserve(56 + events.size() * sizeof(TraceEventEx));
+        buffer.append("CSTRACE1", 8);
+        TraceWrite(buffer, (uint32_t)1);
+        TraceWrite(buffer, (uint32_t)sizeof(TraceEventEx));
+        TraceWrite(buffer, _start_tsc);
+        TraceWrite(buffer, _start_ns);
+        TraceWrite(buffer, TraceTimestamp());
+        TraceWrite(buffer, TraceNow());
+        TraceWrite(buffer, (uint64_t)events.size());
+        if (!events.empty())
+            buffer.append((const char*)events.data(), events.size() * sizeof(TraceEventEx));
+        return buffer;
+    }
+
+    array<Byte>^ Trace::Dump()
+    {
+        std::string buffer = _trace->get()->Dump();
+
+        array<Byte>^ bytes = gcnew array<Byte>((int)buffer.size());
+        if (buffer.size() > 0)
+        {
+            pin_ptr<Byte> ptr = &bytes[bytes->GetLowerBound(0)];
+            memcpy(ptr, buffer.data(), buffer.size());
+        }
+        return bytes;
+    }
+
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "Service.h"
+
+#include <system/uuid.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace CSharpServer {
+
+    //! Trace event
+    /*!
+        Compact 32 bytes binary event. Timestamp is taken from the CPU time stamp
+        counter (the performance counter on CPUs without it), Id is the first 8
+        bytes of the session, client or server UUID (so its 16 hex digits are the
+        first three groups of the Id string without the dashes).
+    */
+    struct TraceEventEx
+    {
+        uint64_t timestamp;
+        uint64_t id;
+        uint64_t value;
+        uint32_t thread;
+        uint16_t type;
+        uint16_t reserved;
+    };
+
+    //! Event trace
+    /*!
+        Fixed set of rings of binary events for connection and I/O lifecycle.
+        Threads write into the ring selected by the hash of the thread Id, so
+        a few service threads mostly get separate rings, but threads may share
+        a ring. Recording is lock-free either way and takes a time stamp counter
+        read and an atomic increment that gives each writer its own slot.
+        Old events are overwritten when a ring is full.
+        Rings are copied by the dump on demand without stopping writers, events
+        overwritten during the copy are skipped.
+
+        Thread-safe.
+    */
+    class TraceEx
+    {
+    public:
+        //! Trace event type
+        enum Type : uint16_t
+        {
+            Connected = 1,      //!< Connection accepted or established
+            HandshakeStart,     //!< SSL handshake started
+            HandshakeEnd,       //!< SSL handshake finished (value is the handshake time in nanoseconds)
+            Received,           //!< Read completion (value is the received size)
+            Sent,               //!< Write completion (value is the sent size)
+            SendQueue,          //!< Send queue growth (value is the bytes pending after the send)
+            Disconnected,       //!< Disconnected
+            Error,              //!< Error (value is the error code, the disconnect reason of the next disconnect)
+            Timer,              //!< Timer fired (value is 1 if the timer was canceled)
+            Expired             //!< Timer wheel tick (value is the count of expired timers)
+        };
+
+        TraceEx();
+        TraceEx(const TraceEx&) = delete;
+        TraceEx(TraceEx&&) = delete;
+        ~TraceEx() = default;
+
+        TraceEx& operator=(const TraceEx&) = delete;
+        TraceEx& operator=(TraceEx&&) = delete;
+
+        bool enabled() const noexcept { return _enabled.load(std::memory_order_relaxed); }
+        uint64_t events() const noexcept;
+        size_t capacity() const noexcept { return Rings * RingSize; }
+
+        //! Enable or disable tracing
+        void SetupTracing(bool enable) noexcept { _enabled = enable; }
+
+        //! Record the event if tracing is enabled
+        /*!
+            \param type - Event type
+            \param id - Session, client or server Id
+            \param value - Event value
+        */
+        void Record(Type type, const CppCommon::UUID& id, uint64_t value = 0) noexcept { if (enabled()) Write(type, Id(id), value); }
+        //! Record the event without Id if tracing is enabled
+        void Record(Type type, uint64_t value = 0) noexcept { if (enabled()) Write(type, 0, value); }
+
+        //! Copy all traced events ordered by timestamp
+        std::vector<TraceEventEx> Snapshot() const;
+        //! Dump all traced events in the binary trace format
+        /*!
+            Binary trace starts with the header: 'CSTRACE1' magic, uint32 version,
+            uint32 event size, uint64 start time stamp counter, int64 start steady
+            clock nanoseconds, uint64 dump time stamp counter, int64 dump steady
+            clock nanoseconds, uint64 events count. Events follow the header.
+            All values are little-endian. Use tools/trace/trace2json.py to convert
+            the trace into Chrome trace JSON.
+
+            \return Binary trace
+        */
+        std::string Dump() const;
+
+    private:
+        static const size_t Rings = 16;
+        static const size_t RingSize = 4096;
+
+        struct Slot
+        {
+            std::atomic<uint64_t> sequence;
+            TraceEventEx event;
+        };
+
+        struct Ring
+        {
+            std::atomic<uint64_t> head{0};
+            uint8_t padding[64 - sizeof(std::atomic<uint64_t>)];
+            std::unique_ptr<Slot[]> slots;
+        };
+
+        std::atomic<bool> _enabled{false};
+        uint64_t _start_tsc;
+        int64_t _start_ns;
+        Ring _rings[Rings];
+
+        void Write(Type type, uint64_t id, uint64_t value) noexcept;
+
+        static uint64_t Id(const CppCommon::UUID& id) noexcept;
+    };
+
+    //! Trace
+    /*!
+        Event trace of the service. Servers, clients and timers created with the
+        service record compact events of the connection and I/O lifecycle: accept,
+        handshake, read and write completions, send queue growth, errors,
+        disconnects and timer fires. Tracing is cheap enough to be always on and
+        the trace is dumped on demand.
+
+        Thread-safe.
+    */
+    public ref class Trace
+    {
+    public:
+        ~Trace() { this->!Trace(); }
+
+        //! Is the tracing enabled?
+        property bool OptionTracing { bool get() { return _trace->get()->enabled(); } }
+        //! Get the number of recorded events
+        property long long Events { long long get() { return (long long)_trace->get()->events(); } }
+        //! Get the maximal number of kept events
+        property long long Capacity { long long get() { return (long long)_trace->get()->capacity(); } }
+
+        //! Setup the tracing
+        /*!
+            \param enable - Enable tracing (default is false)
+        */
+        void SetupTracing(bool enable) { _trace->get()->SetupTracing(enable); }
+
+        //! Dump the trace
+        /*!
+            \return Binary trace
+        */
+        array<Byte>^ Dump();
+        //! Dump the trace into the file
+        /*!
+            \param path - Trace file path
+        */
+        void Dump(String^ path) { System::IO::File::WriteAllBytes(path, Dump()); }
+
+    protected:
+        !Trace() { _trace.Release(); }
+
+    internal:
+        Trace(const std::shared_ptr<TraceEx>& trace) : _trace(new std::shared_ptr<TraceEx>(trace)) {}
+
+        Embedded<std::shared_ptr<TraceEx>> _trace;
+    };
+
+}
@@ -0,0 +1,223 @@
+#include "stdafx.h"
+
+#include "Transmit.h"
+
+#include <mswsock.h>
+
+namespace CSharpServer {
+
+    void SendFileEx::Attach(const std::shared_ptr<asio::io_service>& service, const std::weak_ptr<void>& owner, asio::ip::tcp::socket& socket, const Writer& writer, const Idle& idle, const Handler& handler, SendFileTotalsEx* totals)
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        _service = service;
+        _owner = owner;
+        _socket = &socket;
+        _writer = writer;
+        _idle = idle;
+        _handler = handler;
+        _totals = totals;
+        _sent = 0;
+        _enabled.store(true, std::memory_order_release);
+    }
+
+    void SendFileEx::Detach()
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        _enabled.store(false, std::memory_order_release);
+
+        // Drop files and data which cannot be sent anymore, the file handle
+        // in transmission is closed by its completion handler
+        ++_generation;
+        _items.clear();
+        _transmitting = false;
+        Account(0, _pending, 0);
+        _active = false;
+    }
+
+    HANDLE SendFileEx::Open(const std::wstring& path) noexcept
+    {
+        return ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    }
+
+    HANDLE SendFileEx::Duplicate(HANDLE file) noexcept
+    {
+        HANDLE result;
+        if (!::DuplicateHandle(::GetCurrentProcess(), file, ::GetCurrentProcess(), &result, 0, FALSE, DUPLICATE_SAME_ACCESS))
+            return INVALID_HANDLE_VALUE;
+        return result;
+    }
+
+    bool SendFileEx::Range(HANDLE file, uint64_t offset, uint64_t& size) noexcept
+    {
+        LARGE_INTEGER length;
+        if (!::GetFileSizeEx(file, &length) || (offset > (uint64_t)length.QuadPart))
+            return false;
+
+        uint64_t available = (uint64_t)length.QuadPart - offset;
+        if (size == 0)
+            size = available;
+        return (size <= available);
+    }
+
+    bool SendFileEx::Send(HANDLE file, uint64_t offset, uint64_t size)
+    {
+        std::shared_ptr<void> handle(file, [](void* file) { ::CloseHandle((HANDLE)file); });
+
+        std::lock_guard<std::mutex> locker(_lock);
+
+        if (!enabled())
+            return false;
+
+        if (size == 0)
+            return true;
+
+        Item item;
+        item.file = handle;
+        item.offset = offset;
+        item.size = size;
+        _items.push_back(std::move(item));
+        Account((size_t)size, 0, 0);
+        _active = true;
+
+        // Start at once if the send buffer is already empty
+        Pump();
+        return true;
+    }
+
+    bool SendFileEx::Write(const void* buffer, size_t size)
+    {
+        std::lock_guard<std::mutex> locker(_lock);
+
+        // Nothing is queued, so the data goes into the send buffer and a file queued
+        // after it waits for the empty send buffer
+        if (!enabled() || _items.empty())
+            return _writer && _writer(buffer, size);
+
+        // Coalesce data held after the same file
+        if (_items.back().file)
+            _items.emplace_back();
+
+        const uint8_t* bytes = (const uint8_t*)buffer;
+        std::vector<uint8_t>& data = _items.back().data;
+        data.insert(data.end(), bytes, bytes + size);
+        Account(size, 0, 0);
+        return true;
+    }
+
+    bool SendFileEx::Resume()
+    {
+        if (!active())
+            return false;
+
+        std::lock_guard<std::mutex> locker(_lock);
+
+        bool waiting = !_items.empty();
+        Pump();
+        return waiting;
+    }
+
+    bool SendFileEx::Disconnected(const std::error_code& ec) noexcept
+    {
+        return (ec == asio::error::connection_aborted) ||
+               (ec == asio::error::connection_refused) ||
+               (ec == asio::error::connection_reset) ||
+               (ec == asio::error::eof) ||
+               (ec == asio::error::operation_aborted);
+    }
+
+    void SendFileEx::Pump()
+    {
+        if (!enabled() || _transmitting || _items.empty() || !_idle())
+            return;
+
+        if (_items.front().file)
+        {
+            Transmit();
+            return;
+        }
+
+        // Held data goes into the send buffer and the next file waits for its empty notification
+        std::vector<uint8_t> data;
+        data.swap(_items.front().data);
+        _items.pop_front();
+        Account(0, data.size(), 0);
+        _active = !_items.empty();
+        _writer(data.data(), data.size());
+    }
+
+    void SendFileEx::Account(size_t queued, size_t done, size_t transmitted) noexcept
+    {
+        _pending += queued;
+        _pending -= done;
+        _sent += transmitted;
+
+        if (_totals != nullptr)
+        {
+            _totals->pending += queued;
+            _totals->pending -= done;
+            _totals->sent += transmitted;
+        }
+    }
+
+    void SendFileEx::Transmit()
+    {
+        auto owner = _owner.lock();
+        if (!owner)
+            return;
+
+        Item& item = _items.front();
+        DWORD size = (DWORD)((item.size < MaxTransmit) ? item.size : MaxTransmit);
+        uint64_t generation = _generation;
+        std::shared_ptr<void> file = item.file;
+
+        _transmitting = true;
+
+        asio::windows::overlapped_ptr overlapped(*_service, [this, owner, file, generation](const std::error_code& ec, size_t transmitted)
+        {
+            Transmitted(generation, ec, transmitted);
+        });
+        overlapped.get()->Offset = (DWORD)(item.offset & 0xFFFFFFFF);
+        overlapped.get()->OffsetHigh = (DWORD)(item.offset >> 32);
+
+        // File content goes from the file cache into the socket without user space copies
+        BOOL result = ::TransmitFile(_socket->native_handle(), (HANDLE)file.get(), size, 0, overlapped.get(), nullptr, 0);
+        DWORD error = ::GetLastError();
+        if (!result && (error != ERROR_IO_PENDING))
+            overlapped.complete(std::error_code(error, asio::error::get_system_category()), 0);
+        else
+            overlapped.release();
+    }
+
+    void SendFileEx::Transmitted(uint64_t generation, std::error_code ec, size_t size)
+    {
+        {
+            std::lock_guard<std::mutex> locker(_lock);
+
+            // Skip the transmission of the detached connection
+            if (!enabled() || (generation != _generation))
+                return;
+
+            _transmitting = false;
+
+            // Zero bytes transmitted means the file was truncated
+            if (!ec && (size == 0))
+                ec = asio::error::eof;
+
+            if (!ec)
+            {
+                Item& item = _items.front();
+                item.offset += size;
+                item.size -= size;
+                if (item.size == 0)
+                    _items.pop_front();
+                Account(0, size, size);
+                _active = !_items.empty();
+            }
+        }
+
+        _handler(ec, size);
+    }
+
+}
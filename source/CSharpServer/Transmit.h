@@ -0,0 +1,159 @@
+#pragma once
+
+#include "Service.h"
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace CSharpServer {
+
+    //! Totals of file sends of all sessions of the server
+    struct SendFileTotalsEx
+    {
+        std::atomic<size_t> pending{0};
+        std::atomic<uint64_t> sent{0};
+    };
+
+    //! Send file
+    /*!
+        Transmits files from the kernel file cache into the socket with TransmitFile()
+        without copying file content through the user space. Files are queued in order
+        with sends of the session or client: data sent after the file is held until the
+        file is transmitted, and the file transmission starts only when the send buffer
+        is empty. All sends go through Write(), which decides to hold or to write under
+        the same lock that starts the transmission, so the socket always has a single
+        writer.
+
+        Thread-safe.
+    */
+    class SendFileEx
+    {
+    public:
+        //! Writer of the held data into the send buffer
+        typedef std::function<bool(const void*, size_t)> Writer;
+        //! Predicate of the empty send buffer
+        typedef std::function<bool()> Idle;
+        //! Handler of the transmitted file part (error, sent bytes)
+        typedef std::function<void(const std::error_code&, size_t)> Handler;
+
+        SendFileEx() = default;
+        SendFileEx(const SendFileEx&) = delete;
+        SendFileEx(SendFileEx&&) = delete;
+        ~SendFileEx() = default;
+
+        SendFileEx& operator=(const SendFileEx&) = delete;
+        SendFileEx& operator=(SendFileEx&&) = delete;
+
+        bool enabled() const noexcept { return _enabled.load(std::memory_order_acquire); }
+        //! Is any file or held data waiting to be sent?
+        bool active() const noexcept { return _active.load(std::memory_order_acquire); }
+        //! Get the number of file and held bytes waiting to be sent
+        size_t pending() const noexcept { return _pending.load(std::memory_order_relaxed); }
+        //! Get the number of transmitted file bytes
+        uint64_t sent() const noexcept { return _sent.load(std::memory_order_relaxed); }
+
+        //! Attach the file sender to the connected session or client
+        /*!
+            \param service - Asio service of the owner
+            \param owner - Owner of the file sender (kept alive while the file is transmitted)
+            \param socket - Connected socket of the owner
+            \param writer - Writer of the held data into the send buffer
+            \param idle - Predicate of the empty send buffer
+            \param handler - Handler of the transmitted file parts
+            \param totals - Totals of the server to update (optional)
+        */
+        void Attach(const std::shared_ptr<asio::io_service>& service, const std::weak_ptr<void>& owner, asio::ip::tcp::socket& socket, const Writer& writer, const Idle& idle, const Handler& handler, SendFileTotalsEx* totals = nullptr);
+        //! Detach the file sender from the disconnected owner and drop waiting files and data
+        void Detach();
+
+        //! Queue the file to send
+        /*!
+            \param file - File handle (owned by the file sender, closed when the file is sent or dropped)
+            \param offset - File offset
+            \param size - Number of bytes to send (resolved with Range())
+            \return 'true' if the file was queued, 'false' if the file sender is detached
+        */
+        bool Send(HANDLE file, uint64_t offset, uint64_t size);
+        //! Write data into the send buffer or hold it after the queued file
+        /*!
+            \param buffer - Buffer to send
+            \param size - Buffer size
+            \return 'true' if the data was written or held, 'false' if the write failed
+        */
+        bool Write(const void* buffer, size_t size);
+        //! Continue with the next file or held data once the send buffer is empty
+        /*!
+            The file sender does not continue by itself after the transmitted part,
+            the owner calls Resume() from its empty notification, which may come
+            from the handler of the transmitted part. The next part is transmitted
+            asynchronously, so the handler does not recurse.
+
+            \return 'true' if files or held data are still waiting, 'false' if everything was sent
+        */
+        bool Resume();
+
+        //! Open the file to send
+        /*!
+            \param path - File path
+            \return File handle or INVALID_HANDLE_VALUE if the file cannot be opened
+        */
+        static HANDLE Open(const std::wstring& path) noexcept;
+        //! Duplicate the file handle to send
+        /*!
+            \param file - File handle of the caller
+            \return Duplicated file handle or INVALID_HANDLE_VALUE if the handle cannot be duplicated
+        */
+        static HANDLE Duplicate(HANDLE file) noexcept;
+        //! Resolve the range of the file to send
+        /*!
+            \param file - File handle
+            \param offset - File offset
+            \param size - Number of bytes to send (0 - up to the end of the file), updated with the resolved size
+            \return 'true' if the range is within the file, 'false' otherwise
+        */
+        static bool Range(HANDLE file, uint64_t offset, uint64_t& size) noexcept;
+        //! Is the error of the file transmission an ordinary disconnect?
+        static bool Disconnected(const std::error_code& ec) noexcept;
+
+    private:
+        //! Max number of bytes of a single TransmitFile() call
+        static const uint64_t MaxTransmit = 0x40000000;
+
+        struct Item
+        {
+            std::shared_ptr<void> file;
+            uint64_t offset{0};
+            uint64_t size{0};
+            std::vector<uint8_t> data;
+        };
+
+        std::mutex _lock;
+        std::atomic<bool> _enabled{false};
+        std::atomic<bool> _active{false};
+        std::shared_ptr<asio::io_service> _service;
+        std::weak_ptr<void> _owner;
+        asio::ip::tcp::socket* _socket{nullptr};
+        Writer _writer;
+        Idle _idle;
+        Handler _handler;
+        SendFileTotalsEx* _totals{nullptr};
+        std::deque<Item> _items;
+        bool _transmitting{false};
+        uint64_t _generation{0};
+        std::atomic<size_t> _pending{0};
+        std::atomic<uint64_t> _sent{0};
+
+        //! Account waiting and transmitted bytes in the file sender and in the server totals
+        void Account(size_t queued, size_t done, size_t transmitted) noexcept;
+        //! Start the next file or write the next held data
+        void Pump();
+        //! Transmit the next part of the file at the queue front
+        void Transmit();
+        //! Complete the transmitted part of the file at the queue front
+        void Transmitted(uint64_t generation, std::error_code ec, size_t size);
+    };
+
+}
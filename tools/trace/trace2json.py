@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""Convert CSharpServer binary trace into Chrome trace JSON.
+
+Binary trace is produced by Service.Trace.Dump(). The output can be opened
+with chrome://tracing or https://ui.perfetto.dev.
+
+Usage: trace2json.py trace.bin [trace.json]
+"""
+
+import json
+import struct
+import sys
+
+HEADER = struct.Struct('<8sIIQqQqQ')
+EVENT = struct.Struct('<QQQIHH')
+
+CONNECTED = 1
+HANDSHAKE_START = 2
+HANDSHAKE_END = 3
+RECEIVED = 4
+SENT = 5
+SEND_QUEUE = 6
+DISCONNECTED = 7
+ERROR = 8
+TIMER = 9
+EXPIRED = 10
+
+NAMES = {
+    CONNECTED: 'connected',
+    HANDSHAKE_START: 'handshake start',
+    HANDSHAKE_END: 'handshake end',
+    RECEIVED: 'received',
+    SENT: 'sent',
+    SEND_QUEUE: 'send queue',
+    DISCONNECTED: 'disconnected',
+    ERROR: 'error',
+    TIMER: 'timer',
+    EXPIRED: 'expired',
+}
+
+
+def read_trace(data):
+    magic, version, size, start_tsc, start_ns, dump_tsc, dump_ns, count = HEADER.unpack_from(data, 0)
+    if magic != b'CSTRACE1' or version != 1:
+        raise ValueError('Not a CSharpServer trace')
+    if size < EVENT.size:
+        raise ValueError('Unsupported trace event size: {}'.format(size))
+
+    # Convert time stamp counter ticks to steady clock microseconds with the frequency measured between start and dump
+    scale = (dump_ns - start_ns) / (dump_tsc - start_tsc) if dump_tsc != start_tsc else 1.0
+
+    events = []
+    offset = HEADER.size
+    for _ in range(count):
+        timestamp, id, value, thread, type, _ = EVENT.unpack_from(data, offset)
+        offset += size
+        events.append(((start_ns + (timestamp - start_tsc) * scale) / 1000.0, id, value, thread, type))
+    return events
+
+
+def convert(events):
+    result = []
+    errors = {}
+    for ts, id, value, thread, type in events:
+        name = NAMES.get(type, 'event {}'.format(type))
+        key = '{:016x}'.format(id)
+        common = {'pid': 1, 'tid': thread, 'ts': ts}
+
+        # Connection and handshake spans are async events bound by the Id, because they could span several threads
+        if type == CONNECTED:
+            result.append(dict(common, name='connection', cat='connection', ph='b', id=key, args={'id': key}))
+        elif type == DISCONNECTED:
+            args = {'id': key}
+            if id in errors:
+                args['reason'] = errors.pop(id)
+            result.append(dict(common, name='connection', cat='connection', ph='e', id=key, args=args))
+        elif type == HANDSHAKE_START:
+            result.append(dict(common, name='handshake', cat='ssl', ph='b', id=key))
+        elif type == HANDSHAKE_END:
+            result.append(dict(common, name='handshake', cat='ssl', ph='e', id=key, args={'duration_ns': value}))
+        elif type == SEND_QUEUE:
+            result.append(dict(common, name='send queue ' + key, cat='io', ph='C', args={'pending': value}))
+        elif type == ERROR:
+            error = struct.unpack('<q', struct.pack('<Q', value))[0]
+            errors[id] = error
+            result.append(dict(common, name=name, cat='error', ph='i', s='t', args={'id': key, 'error': error}))
+        elif type in (RECEIVED, SENT):
+            result.append(dict(common, name=name, cat='io', ph='i', s='t', args={'id': key, 'size': value}))
+        elif type == TIMER:
+            result.append(dict(common, name=name, cat='timer', ph='i', s='t', args={'canceled': bool(value)}))
+        elif type == EXPIRED:
+            result.append(dict(common, name=name, cat='timer', ph='i', s='t', args={'count': value}))
+        else:
+            result.append(dict(common, name=name, ph='i', s='t', args={'id': key, 'value': value}))
+    return {'traceEvents': result, 'displayTimeUnit': 'ns'}
+
+
+def main(argv):
+    if len(argv) < 2:
+        print(__doc__)
+        return 1
+
+    with open(argv[1], 'rb') as file:
+        events = read_trace(file.read())
+
+    trace = convert(events)
+    if len(argv) > 2:
+        with open(argv[2], 'w') as file:
+            json.dump(trace, file)
+    else:
+        json.dump(trace, sys.stdout)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))